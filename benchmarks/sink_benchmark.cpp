@@ -0,0 +1,75 @@
+#include "logger.hpp"
+
+#include <cstdlib>
+
+// Measures synchronous logging throughput into the file for each sink. The logger can only
+// be initialized once per process, so without arguments the benchmark runs itself once per sink.
+
+constexpr int NUM_LINES = 1000000;
+constexpr size_t MESSAGE_LENGTH = 100;
+constexpr size_t PREFIX_LENGTH = sizeof("[YYYY-MM-DD HH:MM:SS.mmm] [INFO ] ") - 1;
+
+static int runSink(const std::string &name)
+{
+  LoggerConfig config;
+  std::string path = "./logs/sink_benchmark_" + name + ".log";
+  config.logFilePath = path.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = static_cast<size_t>(1) << 30;
+
+  if (name == "stream")
+    config.sink = SinkType::STREAM;
+  else if (name == "fd")
+    config.sink = SinkType::FD;
+  else if (name == "uring")
+    config.sink = SinkType::IO_URING;
+  else if (name == "mmap")
+    config.sink = SinkType::MMAP;
+  else
+  {
+    std::cerr << "Unknown sink: " << name << "\n";
+    return 1;
+  }
+
+  std::filesystem::remove(path);
+  if (!Logger::getInstance().init(config))
+    return 1;
+
+  // Counted up front: the mmap sink keeps the file at its full segment size until close
+  std::string message(MESSAGE_LENGTH, 'x');
+  double bytes = 0;
+  for (int i = 0; i < NUM_LINES; i++)
+  {
+    bytes += PREFIX_LENGTH + snprintf(nullptr, 0, "%d %s", i, message.c_str()) + 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_LINES; i++)
+  {
+    LOG_INFO("%d %s", i, message.c_str());
+  }
+  Logger::getInstance().flush();
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << std::left << std::setw(8) << name
+            << std::fixed << std::setprecision(1) << bytes / elapsed / (1024 * 1024) << " MiB/s, "
+            << std::setprecision(0) << NUM_LINES / elapsed << " lines/s\n";
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1)
+  {
+    return runSink(argv[1]);
+  }
+
+  int result = 0;
+  for (const char *sink : {"stream", "fd", "uring", "mmap"})
+  {
+    std::string command = std::string(argv[0]) + " " + sink;
+    if (std::system(command.c_str()) != 0)
+      result = 1;
+  }
+  return result;
+}
@@ -13,13 +13,52 @@
 #include <cstdio>
 #include <filesystem>
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <bit>
+#include <version>
+#if __has_include(<format>)
+#include <format>
+#endif
+
+#if defined(__cpp_lib_format)
+#define LOGGER_HAS_STD_FORMAT 1
+#endif
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
 
 #define BUFFER_SIZE 256
 #define TIME_STAMP_BUFFER 64
 #define MAX_FILE_SIZE 32768
 #define LOG_FILE_PATH "./logs/logger.log"
 #define LOG_BUFFER_CAPACITY 100
+#define LOG_BUFFER_BYTES (LOG_BUFFER_CAPACITY * BUFFER_SIZE) // Pending bytes that trigger a flush
 #define FLUSH_INTERVAL_MS 1000
+#define LOG_SYNC_INTERVAL_MS 1000
+#define LOG_SYNC_INTERVAL_BYTES (1024 * 1024)
+#define CACHE_LINE_SIZE 64
+
+#define LOGGER_LEVEL_ERROR 0
+#define LOGGER_LEVEL_WARNING 1
+#define LOGGER_LEVEL_INFO 2
+#define LOGGER_LEVEL_DEBUG 3
+
+// LOG_* macros below this severity compile to nothing, set through the LOGGER_ACTIVE_LEVEL CMake option
+#ifndef LOGGER_ACTIVE_LEVEL
+#define LOGGER_ACTIVE_LEVEL LOGGER_LEVEL_DEBUG
+#endif
+#define LOG_QUEUE_CAPACITY 512 // Records per producer thread, rounded up to a power of two
+#define LOG_RECORD_SIZE BUFFER_SIZE // Message or captured argument bytes per queue slot
+#define LOG_LINE_SIZE (BUFFER_SIZE + TIME_STAMP_BUFFER + 16)
+#define CLOCK_SYNC_INTERVAL_MS 1000
+#define LOG_NEXT_FILE_SUFFIX ".next"       // Pre-opened file the next rotation switches to
+#define LOG_MAX_ARCHIVE_FILES 10
+#define LOG_COMPRESSION_THREADS 1          // Archives compressed at the same time
+#define LOG_URING_BUFFER_COUNT 8           // Registered buffers, i.e. writes in flight
+#define LOG_URING_BUFFER_SIZE (64 * 1024)
 
 typedef std::mutex MutexType;
 
@@ -31,24 +70,150 @@ enum class LogLevel
   DEBUG
 };
 
+enum class OverflowPolicy
+{
+  BLOCK = 0,       // Wait for the backend to free a slot
+  DROP_NEWEST,     // Discard the record being logged
+  OVERWRITE_OLDEST // Discard the oldest queued record of the same thread
+};
+
+enum class ClockSource
+{
+  SYSTEM = 0,     // std::chrono::system_clock
+  REALTIME_COARSE // CLOCK_REALTIME_COARSE on Linux: cheaper, resolution of a scheduler tick
+};
+
+enum class SinkType
+{
+  STREAM = 0, // std::ofstream
+  FD,         // O_APPEND file descriptor written with write()/writev(); STREAM on Windows
+  IO_URING,   // Linux io_uring writes from registered buffers; FD where io_uring is unavailable
+  MMAP        // memcpy into the file allocated and mapped at maxFileSize, truncated on close; STREAM on Windows
+};
+
+enum class ArchiveNaming
+{
+  BACKUP = 0, // A single <path>.bak, replaced on every rotation
+  NUMBERED,   // <path>.1, <path>.2, ... in rotation order
+  TIMESTAMPED // <path>.YYYYMMDD-HHMMSS, with .N added for rotations within the same second
+};
+
+enum class RotationInterval
+{
+  NONE = 0,
+  HOURLY, // Archives named <path>.YYYYMMDD-HH after the hour they cover
+  DAILY   // Archives named <path>.YYYYMMDD
+};
+
+enum class Compression
+{
+  NONE = 0,
+  GZIP, // Needs zlib at build time (LOGGER_HAVE_ZLIB), otherwise archives stay uncompressed
+  ZSTD  // Needs libzstd at build time (LOGGER_HAVE_ZSTD), otherwise GZIP
+};
+
+enum class DurabilityMode
+{
+  NONE = 0, // Leave write-back to the OS
+  PERIODIC, // fdatasync every syncIntervalMs or syncIntervalBytes, whichever comes first
+  ON_ERROR  // fdatasync right after each LogLevel::ERR line
+};
+
+enum class TimestampPrecision
+{
+  MILLISECONDS = 3,
+  MICROSECONDS = 6,
+  NANOSECONDS = 9
+};
+
+struct LogRecord
+{
+  LogLevel level;
+  const char *format; // Set when text holds captured arguments instead of the formatted message
+  uint64_t ticks;     // Raw TickClock reading, converted to wall time by the backend
+  uint32_t chunk;     // Longer messages span chunkCount consecutive slots
+  uint32_t chunkCount;
+  uint32_t length;
+  char text[LOG_RECORD_SIZE];
+};
+
+class SpscQueue;
+class TickClock;
+class LogSink;
+
+struct LoggerConfig
+{
+  const char *logFilePath = LOG_FILE_PATH;
+  LogLevel level = LogLevel::INFO;
+  bool consoleOutput = true;
+  size_t maxFileSize = MAX_FILE_SIZE;
+  bool asyncMode = false; // Hand records to a backend thread that owns the file
+  size_t queueCapacity = LOG_QUEUE_CAPACITY;
+  OverflowPolicy overflowPolicy = OverflowPolicy::BLOCK;
+  bool deferredFormatting = false; // Async only: format on the backend, format strings must be literals
+  ClockSource clockSource = ClockSource::SYSTEM; // Caller-side clock; async records use TickClock
+  TimestampPrecision timestampPrecision = TimestampPrecision::MILLISECONDS;
+  bool utcTimestamps = false; // Print UTC instead of local time, skipping localtime_r
+  SinkType sink = SinkType::FD;
+  size_t preallocateSize = 0; // Linux, FD and IO_URING: reserve file blocks ahead of appends in extents this large, 0 disables
+  RotationInterval rotationInterval = RotationInterval::NONE; // In addition to maxFileSize; overrides archiveNaming
+  ArchiveNaming archiveNaming = ArchiveNaming::BACKUP;
+  size_t maxArchiveFiles = LOG_MAX_ARCHIVE_FILES; // NUMBERED/TIMESTAMPED only, 0 for no limit
+  uint64_t maxArchiveBytes = 0;                   // Total size of archives, 0 for no limit
+  Compression compression = Compression::NONE;    // Applied to archives by low-priority threads
+  unsigned compressionThreads = LOG_COMPRESSION_THREADS;
+  DurabilityMode durability = DurabilityMode::NONE;
+  unsigned syncIntervalMs = LOG_SYNC_INTERVAL_MS;       // PERIODIC only, 0 disables
+  size_t syncIntervalBytes = LOG_SYNC_INTERVAL_BYTES;   // PERIODIC only, 0 disables
+};
+
 class Logger
 {
 public:
-  static Logger &getInstance();
+  // Inline so the level check in the LOG_* macros compiles down to a guard test and a load
+  static Logger &getInstance()
+  {
+    static Logger instance;
+    return instance;
+  }
 
   Logger(const Logger &) = delete;
   Logger &operator=(const Logger &) = delete;
   bool init(const char *logFilePath, LogLevel level = LogLevel::INFO,
             bool consoleOutput = true, size_t maxFileSize = MAX_FILE_SIZE);
+  bool init(const LoggerConfig &config);
 
   void log(LogLevel level, const char *format, ...);
+  void vlog(LogLevel level, const char *format, va_list args);
+#ifdef LOGGER_HAS_STD_FORMAT
+  template <typename... Args>
+  void print(LogLevel level, std::format_string<Args...> format, Args &&...args);
+#endif
   void error(const char *format, ...);
   void warning(const char *format, ...);
   void info(const char *format, ...);
   void debug(const char *format, ...);
   void setLevel(LogLevel level);
+
+  bool isEnabled(LogLevel level) const
+  {
+    return level <= m_currentLevel.load(std::memory_order_relaxed);
+  }
   void setConsoleOutput(bool enable);
   void flush();
+  uint64_t droppedCount() const;
+
+#ifdef LOGGER_TESTING
+  // Test seam, defined only for the test build: ends the current rotation period, named
+  // stamp, now. Call while no other thread logs.
+  void endRotationPeriodForTesting(const std::string &stamp)
+  {
+    m_periodStamp = stamp;
+    m_nextRotationTime = std::chrono::steady_clock::now();
+  }
+
+  std::chrono::steady_clock::time_point nextRotationTimeForTesting() const { return m_nextRotationTime; }
+#endif
 
 private:
   Logger();
@@ -56,30 +221,226 @@ private:
 
   void lockMutex();
   void unlockMutex();
+  void writeEntry(LogLevel level, const char *entry, size_t length);
+  void writeMessage(LogLevel level, const char *message, size_t length);
+  template <typename FormatEntry>
+  void submitEntry(LogLevel level, FormatEntry &&formatEntry);
+  void enqueueDeferred(LogLevel level, const char *format, va_list args);
+  void enqueueMessage(LogLevel level, uint64_t ticks, const char *message, size_t length);
+  bool reserveRecords(SpscQueue &queue, size_t count);
+  void writeOversized(SpscQueue &queue, LogLevel level, const char *message, size_t length);
+  void commitRecords(SpscQueue &queue, size_t count);
+  void writeRecord(const LogRecord &record);
+  SpscQueue &producerQueue();
+  bool hasPendingRecords();
+  size_t drainQueues();
+  void startBackend();
+  void stopBackend();
+  void backendLoop();
+  void startMaintenance();
+  void stopMaintenance();
+  void maintenanceLoop();
+  std::unique_ptr<LogSink> createSink() const;
   bool openLogFile();
   void closeLogFile();
   void flushBuffer();
+  void syncLogFile(bool wait);
   bool createLogDirectory(const std::string &filePath);
   bool validateLogPath(const std::string &path);
-  void checkRotation(size_t messageSize);
-  void rotateLogFile();
+  void checkRotation(size_t messageSize, std::chrono::steady_clock::time_point now);
+  bool rotateLogFile(const std::string &archivePath);
+  void rollBackRotation();
+  void waitForRotation();
+  void addArchive(const std::string &archivePath);
+  void schedulePeriodRotation();
+  std::string nextArchivePath();
+  void recoverArchives();
+  void loadArchives();
+  void enforceRetention();
+  void startCompression(unsigned threads);
+  void stopCompression();
+  void compressionLoop();
+  void compressArchive(const std::string &path);
+  size_t formatPrefix(char *buffer, std::chrono::system_clock::time_point time, LogLevel level);
+  size_t formatMessage(char *buffer, size_t bufferSize, const char *format, va_list args);
+  std::chrono::system_clock::time_point currentTime() const;
   void getTimestamp(char *buffer, size_t bufferSize);
+  void getTimestamp(std::chrono::system_clock::time_point time, char *buffer, size_t bufferSize);
   const char *logLevelToString(LogLevel level);
 
-  LogLevel m_currentLevel;
+  // Read on every call without the mutex, so they get a cache line nothing else writes to
+  alignas(CACHE_LINE_SIZE) std::atomic<LogLevel> m_currentLevel;
+  std::atomic<bool> m_consoleOutput;
+  std::atomic<bool> m_initialized;
+
+  alignas(CACHE_LINE_SIZE) MutexType m_logMutex;
   std::string m_logFilePath;
   size_t m_maxFileSize;
-  bool m_initialized;
-  bool m_consoleOutput;
-  MutexType m_logMutex;
-  static const size_t m_bufferSize = BUFFER_SIZE;
-  std::ofstream m_logFile;
-  std::vector<std::string> m_messageBuffer;
+  static constexpr size_t m_bufferSize = BUFFER_SIZE;
+  SinkType m_sinkType;
+  size_t m_preallocateSize;
+  std::unique_ptr<LogSink> m_sink;
+  bool m_fileOpen;
+  std::vector<char> m_messageBuffer; // Pending lines back to back, written out in one call
+  size_t m_bufferedCount;
   size_t m_currentFileSize;
   std::chrono::steady_clock::time_point m_lastFlushTime;
+  DurabilityMode m_durability;
+  unsigned m_syncIntervalMs;
+  size_t m_syncIntervalBytes;
+  size_t m_unsyncedBytes;
+  std::chrono::steady_clock::time_point m_lastSyncTime;
+
+  bool m_asyncMode;
+  size_t m_queueCapacity;
+  OverflowPolicy m_overflowPolicy;
+  bool m_deferredFormatting;
+  ClockSource m_clockSource;
+  TimestampPrecision m_timestampPrecision;
+  bool m_utcTimestamps;
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_droppedCount;
+  std::thread m_backendThread;
+  std::mutex m_registryMutex;
+  std::vector<std::shared_ptr<SpscQueue>> m_producerQueues;
+  std::vector<std::shared_ptr<SpscQueue>> m_drainList;
+  std::mutex m_queueMutex;
+  std::condition_variable m_queueCv;
+  std::condition_variable m_drainedCv;
+  std::unique_ptr<TickClock> m_tickClock;
+  std::string m_lineBuffer;
+  std::string m_partialMessage;
+  uint32_t m_partialChunks; // Chunks reassembled so far, from the queue being drained
+  std::atomic<bool> m_backendSleeping;
+  std::atomic<int> m_drainWaiters; // flush() callers and BLOCK producers waiting on m_drainedCv
+  bool m_stopBackend;
+
+  // Rotation switches to m_nextSink and hands the old sink to the maintenance thread, which
+  // renames both files
+  std::thread m_maintenanceThread;
+  std::mutex m_maintenanceMutex;
+  std::condition_variable m_maintenanceCv;
+  std::condition_variable m_maintenanceDoneCv;
+  std::unique_ptr<LogSink> m_nextSink;
+  std::unique_ptr<LogSink> m_retiredSink;
+  std::string m_retiredArchivePath;
+  bool m_nextSinkFailed;
+  bool m_rotationPending;
+  bool m_stopMaintenance;
+  // Set by the maintenance thread when it couldn't archive m_restoredSink's file; checked
+  // on every write, which then switches back to it
+  std::unique_ptr<LogSink> m_restoredSink;
+  std::atomic<bool> m_rotationRolledBack;
+
+  // Rotation at period ends costs one comparison against m_nextRotationTime per line
+  RotationInterval m_rotationInterval;
+  std::chrono::steady_clock::time_point m_nextRotationTime;
+  std::string m_periodStamp;
+
+  // Archived generations, oldest first. Loaded once at init and kept up to date by
+  // addArchive(), so retention never lists the directory.
+  struct ArchiveFile
+  {
+    std::string path;
+    uint64_t size;
+  };
+  ArchiveNaming m_archiveNaming;
+  size_t m_maxArchiveFiles;
+  uint64_t m_maxArchiveBytes;
+  std::mutex m_archiveMutex; // Shared with the compression threads
+  std::deque<ArchiveFile> m_archives;
+  uint64_t m_archiveBytes;
+  uint64_t m_nextArchiveNumber;
+  std::string m_lastArchiveStamp;
+  unsigned m_archiveStampCount;
+
+  Compression m_compression;
+  std::vector<std::thread> m_compressionThreads;
+  std::mutex m_compressionMutex;
+  std::condition_variable m_compressionCv;
+  std::deque<std::string> m_compressionQueue;
+  bool m_stopCompression;
 };
 
-#define LOG_ERROR(...) Logger::getInstance().error(__VA_ARGS__)
-#define LOG_WARNING(...) Logger::getInstance().warning(__VA_ARGS__)
-#define LOG_INFO(...) Logger::getInstance().info(__VA_ARGS__)
-#define LOG_DEBUG(...) Logger::getInstance().debug(__VA_ARGS__)
+#ifdef LOGGER_HAS_STD_FORMAT
+template <typename... Args>
+void Logger::print(LogLevel level, std::format_string<Args...> format, Args &&...args)
+{
+  if (!isEnabled(level) || !m_initialized.load(std::memory_order_acquire))
+  {
+    return;
+  }
+
+  char buffer[m_bufferSize];
+  auto result = std::format_to_n(buffer, m_bufferSize, format, std::forward<Args>(args)...);
+  if (static_cast<size_t>(result.size) <= m_bufferSize)
+  {
+    writeMessage(level, buffer, static_cast<size_t>(result.size));
+    return;
+  }
+
+  // Too long for the stack buffer: format again into a per-thread buffer that keeps its capacity
+  thread_local std::string longMessage;
+  longMessage.clear();
+  std::vformat_to(std::back_inserter(longMessage), format.get(), std::make_format_args(args...));
+  writeMessage(level, longMessage.data(), longMessage.size());
+}
+#endif
+
+// Checks the runtime level before the call so disabled messages don't evaluate their arguments
+// Declares no names of its own, so the arguments see the caller's scope unchanged
+#define LOGGER_LOG_IF_ENABLED(level, call)      \
+  do                                            \
+  {                                             \
+    if (Logger::getInstance().isEnabled(level)) \
+      Logger::getInstance().call;               \
+  } while (0)
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_ERROR
+#define LOG_ERROR(...) LOGGER_LOG_IF_ENABLED(LogLevel::ERR, error(__VA_ARGS__))
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_WARNING
+#define LOG_WARNING(...) LOGGER_LOG_IF_ENABLED(LogLevel::WARNING, warning(__VA_ARGS__))
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_INFO
+#define LOG_INFO(...) LOGGER_LOG_IF_ENABLED(LogLevel::INFO, info(__VA_ARGS__))
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOGGER_LOG_IF_ENABLED(LogLevel::DEBUG, debug(__VA_ARGS__))
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#ifdef LOGGER_HAS_STD_FORMAT
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_ERROR
+#define LOG_ERROR_FMT(...) LOGGER_LOG_IF_ENABLED(LogLevel::ERR, print(LogLevel::ERR, __VA_ARGS__))
+#else
+#define LOG_ERROR_FMT(...) ((void)0)
+#endif
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_WARNING
+#define LOG_WARNING_FMT(...) LOGGER_LOG_IF_ENABLED(LogLevel::WARNING, print(LogLevel::WARNING, __VA_ARGS__))
+#else
+#define LOG_WARNING_FMT(...) ((void)0)
+#endif
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_INFO
+#define LOG_INFO_FMT(...) LOGGER_LOG_IF_ENABLED(LogLevel::INFO, print(LogLevel::INFO, __VA_ARGS__))
+#else
+#define LOG_INFO_FMT(...) ((void)0)
+#endif
+
+#if LOGGER_ACTIVE_LEVEL >= LOGGER_LEVEL_DEBUG
+#define LOG_DEBUG_FMT(...) LOGGER_LOG_IF_ENABLED(LogLevel::DEBUG, print(LogLevel::DEBUG, __VA_ARGS__))
+#else
+#define LOG_DEBUG_FMT(...) ((void)0)
+#endif
+#endif
@@ -1,356 +1,3078 @@
 #include "logger.hpp"
 
-Logger &Logger::getInstance()
+#include <cctype>
+#include <climits>
+
+#ifdef LOGGER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef LOGGER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define LOGGER_HAVE_IO_URING
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Single-producer/single-consumer ring of log records. The owning thread is the
+// only producer and the backend thread the only consumer, so neither side locks.
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity)
+      : m_slots(capacity), m_mask(capacity - 1), m_head(0), m_cachedTail(0),
+        m_tail(0), m_cachedHead(0), m_producerExited(false)
+  {
+  }
+
+  // Only needed under OverflowPolicy::OVERWRITE_OLDEST, where the producer
+  // may advance the head and must not race the consumer reading that slot
+  void lock()
+  {
+    while (m_lock.test_and_set(std::memory_order_acquire))
+      std::this_thread::yield();
+  }
+
+  void unlock() { m_lock.clear(std::memory_order_release); }
+
+  // Checks that count slots are free; they are then filled through slot() and published by commit()
+  bool reserve(size_t count)
+  {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail + count - m_cachedHead > capacity())
+    {
+      m_cachedHead = m_head.load(std::memory_order_acquire);
+      if (tail + count - m_cachedHead > capacity())
+        return false;
+    }
+    return true;
+  }
+
+  LogRecord &slot(size_t offset)
+  {
+    return m_slots[(m_tail.load(std::memory_order_relaxed) + offset) & m_mask];
+  }
+
+  void commit(size_t count)
+  {
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + count, std::memory_order_seq_cst);
+  }
+
+  size_t capacity() const { return m_mask + 1; }
+
+  LogRecord *front()
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head >= m_cachedTail) // The producer may have advanced the head past our cache
+    {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head == m_cachedTail)
+        return nullptr;
+    }
+    return &m_slots[head & m_mask];
+  }
+
+  // Oldest queued record, for the producer under lock() only
+  LogRecord &oldest() { return m_slots[m_head.load(std::memory_order_relaxed) & m_mask]; }
+
+  void pop()
+  {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  size_t head() const { return m_head.load(std::memory_order_seq_cst); }
+  size_t tail() const { return m_tail.load(std::memory_order_seq_cst); }
+  bool empty() const { return head() == tail(); }
+
+  void markProducerExited() { m_producerExited.store(true, std::memory_order_release); }
+  bool producerExited() const { return m_producerExited.load(std::memory_order_acquire); }
+
+private:
+  std::vector<LogRecord> m_slots;
+  const size_t m_mask;
+
+  alignas(64) std::atomic<size_t> m_head; // Written by the consumer
+  size_t m_cachedTail;
+
+  alignas(64) std::atomic<size_t> m_tail; // Written by the producer
+  size_t m_cachedHead;
+
+  alignas(64) std::atomic<bool> m_producerExited;
+  std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+};
+
+// Cheap raw counter read on logging threads. The backend maps readings to wall-clock
+// time from periodic (ticks, steady_clock, system_clock) samples, measuring the tick
+// rate against steady_clock so wall-clock steps don't skew it.
+class TickClock
+{
+public:
+  TickClock() : m_anchorTicks(0), m_nsPerTick(1.0)
+  {
+    sample(m_anchorTicks, m_anchorSteady, m_anchorTime);
+  }
+
+  static uint64_t now()
+  {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__linux__)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  // Takes a new anchor and updates the rate from the ticks elapsed since the previous one
+  void synchronize()
+  {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point steady;
+    std::chrono::system_clock::time_point time;
+    sample(ticks, steady, time);
+
+    auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(steady - m_anchorSteady).count();
+    if (ticks > m_anchorTicks && elapsedNs > 0)
+      m_nsPerTick = static_cast<double>(elapsedNs) / static_cast<double>(ticks - m_anchorTicks);
+
+    m_anchorTicks = ticks;
+    m_anchorSteady = steady;
+    m_anchorTime = time;
+  }
+
+  std::chrono::system_clock::time_point toTime(uint64_t ticks) const
+  {
+    double offsetTicks = static_cast<double>(static_cast<int64_t>(ticks - m_anchorTicks));
+    auto offset = std::chrono::nanoseconds(static_cast<int64_t>(offsetTicks * m_nsPerTick));
+    return m_anchorTime + std::chrono::duration_cast<std::chrono::system_clock::duration>(offset);
+  }
+
+private:
+  static void sample(uint64_t &ticks, std::chrono::steady_clock::time_point &steady,
+                     std::chrono::system_clock::time_point &time)
+  {
+    uint64_t before = now();
+    steady = std::chrono::steady_clock::now();
+    time = std::chrono::system_clock::now();
+    uint64_t after = now();
+    ticks = before + (after - before) / 2;
+  }
+
+  uint64_t m_anchorTicks;
+  std::chrono::steady_clock::time_point m_anchorSteady;
+  std::chrono::system_clock::time_point m_anchorTime;
+  double m_nsPerTick;
+};
+
+#ifndef _WIN32
+static int syncData(int fd)
+{
+#ifdef __APPLE__
+  return fsync(fd);
+#else
+  return fdatasync(fd);
+#endif
+}
+
+// Keeps file blocks reserved ahead of the write position, an extent at a time, so appends
+// don't make the filesystem allocate (and journal) a few blocks per write. Reserved blocks
+// past the end of the file don't change its size; release() hands back what went unused.
+// The first extent is reserved on open, which for the next log file happens on the
+// maintenance thread. Gives up quietly where fallocate() isn't supported.
+class Preallocator
+{
+public:
+  explicit Preallocator(size_t extent) : m_extent(extent) {}
+
+  void reset(size_t fileSize)
+  {
+    m_reserved = fileSize;
+    m_used = false;
+  }
+
+  // Makes sure blocks are reserved up to end
+  void reserve(int fd, size_t end)
+  {
+    if (m_extent == 0 || end <= m_reserved)
+      return;
+
+#ifdef FALLOC_FL_KEEP_SIZE
+    size_t length = std::max(end - m_reserved, m_extent);
+    int result;
+    do
+    {
+      result = fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(m_reserved), static_cast<off_t>(length));
+    } while (result != 0 && errno == EINTR);
+
+    if (result == 0)
+    {
+      m_reserved += length;
+      m_used = true;
+      return;
+    }
+#endif
+    m_extent = 0;
+  }
+
+  // Frees blocks reserved past the end of the file
+  void release(int fd)
+  {
+    struct stat info;
+    if (m_used && fstat(fd, &info) == 0 && ftruncate(fd, info.st_size) != 0)
+      std::cerr << "Failed to release preallocated log file space: " << std::strerror(errno) << "\n";
+    m_used = false;
+  }
+
+private:
+  size_t m_extent;
+  size_t m_reserved = 0;
+  bool m_used = false;
+};
+
+// Extends the file to length bytes with every block allocated, rather than leaving a hole
+static bool allocateFile(int fd, size_t length)
+{
+#ifdef __APPLE__
+  fstore_t store = {F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(length), 0};
+  if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+    return false;
+  return ftruncate(fd, static_cast<off_t>(length)) == 0;
+#else
+  int result;
+  do
+  {
+    result = posix_fallocate(fd, 0, static_cast<off_t>(length));
+  } while (result == EINTR);
+
+  errno = result;
+  return result == 0;
+#endif
+}
+#endif
+
+struct ByteSpan
+{
+  const char *data;
+  size_t length;
+};
+
+// Destination of buffered log bytes. Called by whichever thread holds the log mutex.
+class LogSink
+{
+public:
+  virtual ~LogSink() = default;
+
+  // Opens path for appending; size() then reports its current length
+  virtual bool open(const std::string &path) = 0;
+  virtual void close() = 0;
+  virtual size_t size() const = 0;
+  // Writes the spans back to back
+  virtual bool write(const ByteSpan *spans, size_t count) = 0;
+  // Hands anything still buffered in user space to the OS
+  virtual void flush() = 0;
+  // Makes everything flushed so far durable; may only start the sync, see waitForWrites()
+  virtual void sync() = 0;
+  // Waits until the OS has accepted everything flushed so far
+  virtual void waitForWrites() {}
+};
+
+class StreamSink : public LogSink
+{
+public:
+  ~StreamSink() override { close(); }
+
+  bool open(const std::string &path) override
+  {
+    m_file.open(path, std::ios_base::app | std::ios_base::out);
+    if (!m_file.is_open())
+    {
+      m_file.open(path, std::ios_base::out);
+      if (!m_file.is_open())
+        return false;
+    }
+
+#ifndef _WIN32
+    // The stream doesn't expose its descriptor; syncing another one on the same file
+    // works, and opening it now keeps it pointing there after rotation renames the file
+    m_syncFd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+#endif
+
+    m_file.seekp(0, std::ios_base::end);
+    m_size = static_cast<size_t>(m_file.tellp());
+    return true;
+  }
+
+  void close() override
+  {
+    if (m_file.is_open())
+      m_file.close();
+#ifndef _WIN32
+    if (m_syncFd >= 0)
+    {
+      ::close(m_syncFd);
+      m_syncFd = -1;
+    }
+#endif
+  }
+
+  size_t size() const override { return m_size; }
+
+  bool write(const ByteSpan *spans, size_t count) override
+  {
+    for (size_t i = 0; i < count; i++)
+      m_file.write(spans[i].data, static_cast<std::streamsize>(spans[i].length));
+    return m_file.good();
+  }
+
+  void flush() override { m_file.flush(); }
+
+  void sync() override
+  {
+    m_file.flush();
+#ifndef _WIN32
+    if (m_syncFd >= 0)
+      syncData(m_syncFd);
+#endif
+  }
+
+private:
+  std::ofstream m_file;
+#ifndef _WIN32
+  int m_syncFd = -1;
+#endif
+  size_t m_size = 0;
+};
+
+#ifndef _WIN32
+// Unbuffered: each write() call is one writev() (more only on partial writes)
+class FdSink : public LogSink
+{
+public:
+  explicit FdSink(size_t preallocateSize) : m_preallocator(preallocateSize) {}
+
+  ~FdSink() override { close(); }
+
+  bool open(const std::string &path) override
+  {
+    m_fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+      return false;
+
+    struct stat info;
+    m_size = fstat(m_fd, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    m_end = m_size;
+    m_preallocator.reset(m_size);
+    m_preallocator.reserve(m_fd, m_end + 1);
+    return true;
+  }
+
+  void close() override
+  {
+    if (m_fd >= 0)
+    {
+      m_preallocator.release(m_fd);
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  size_t size() const override { return m_size; }
+
+  bool write(const ByteSpan *spans, size_t count) override
+  {
+    size_t pendingBytes = 0;
+    for (size_t i = 0; i < count; i++)
+      pendingBytes += spans[i].length;
+    m_end += pendingBytes;
+    m_preallocator.reserve(m_fd, m_end);
+
+    iovec iov[16];
+    while (count > 0)
+    {
+      int iovCount = static_cast<int>(std::min<size_t>({count, std::size(iov), IOV_MAX}));
+      size_t total = 0;
+      for (int i = 0; i < iovCount; i++)
+      {
+        iov[i].iov_base = const_cast<char *>(spans[i].data);
+        iov[i].iov_len = spans[i].length;
+        total += spans[i].length;
+      }
+
+      ssize_t written = ::writev(m_fd, iov, iovCount);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+
+      if (static_cast<size_t>(written) == total)
+      {
+        spans += iovCount;
+        count -= iovCount;
+        continue;
+      }
+
+      // Partial write: finish the span it stopped in, then retry the rest
+      size_t remaining = static_cast<size_t>(written);
+      while (remaining >= spans->length)
+      {
+        remaining -= spans->length;
+        spans++;
+        count--;
+      }
+      if (!writeAll(spans->data + remaining, spans->length - remaining))
+        return false;
+      spans++;
+      count--;
+    }
+    return true;
+  }
+
+  void flush() override {}
+
+  void sync() override { syncData(m_fd); }
+
+private:
+  bool writeAll(const char *data, size_t length)
+  {
+    while (length > 0)
+    {
+      ssize_t written = ::write(m_fd, data, length);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += written;
+      length -= static_cast<size_t>(written);
+    }
+    return true;
+  }
+
+  int m_fd = -1;
+  size_t m_size = 0;
+  size_t m_end = 0; // Where the next write lands, barring other writers
+  Preallocator m_preallocator;
+};
+#endif
+
+#ifndef _WIN32
+// Sizes the file to a whole segment up front, with its blocks allocated, and appends by
+// memcpy into its mapping. Writes are serialised by the caller like every other sink's;
+// the file is cut back to the bytes actually written on close. Nothing reaches the disk
+// until the kernel writes the dirty pages back, but the data survives a crash of the process.
+class MmapSink : public LogSink
+{
+public:
+  explicit MmapSink(size_t segmentSize)
+      : m_segmentSize(std::max<size_t>(segmentSize, 1))
+  {
+  }
+
+  ~MmapSink() override { close(); }
+
+  bool open(const std::string &path) override
+  {
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+      return false;
+
+    struct stat info;
+    size_t fileSize = fstat(m_fd, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    if (!map(std::max(fileSize, m_segmentSize)))
+    {
+      std::cerr << "Failed to allocate log file segment: " << std::strerror(errno) << "\n";
+      // Drop the zero padding a failed allocation may have added
+      if (ftruncate(m_fd, static_cast<off_t>(fileSize)) != 0)
+        std::cerr << "Failed to truncate log file: " << std::strerror(errno) << "\n";
+      ::close(m_fd);
+      m_fd = -1;
+      return false;
+    }
+
+    // A segment left behind by a crash still ends in the zero padding of the allocation
+    while (fileSize > 0 && m_data[fileSize - 1] == '\0')
+      fileSize--;
+
+    m_size = fileSize;
+    m_offset = fileSize;
+    m_syncedOffset = fileSize;
+    return true;
+  }
+
+  void close() override
+  {
+    if (m_fd < 0)
+      return;
+
+    munmap(m_data, m_capacity);
+    m_data = nullptr;
+    if (ftruncate(m_fd, static_cast<off_t>(m_offset)) != 0)
+      std::cerr << "Failed to truncate log file: " << std::strerror(errno) << "\n";
+    ::close(m_fd);
+    m_fd = -1;
+  }
+
+  size_t size() const override { return m_size; }
+
+  bool write(const ByteSpan *spans, size_t count) override
+  {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+      total += spans[i].length;
+
+    // Rotation keeps the file within the segment; only a single oversized line grows it
+    if (m_offset + total > m_capacity && !grow(m_offset + total))
+      return false;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      std::memcpy(m_data + m_offset, spans[i].data, spans[i].length);
+      m_offset += spans[i].length;
+    }
+    return true;
+  }
+
+  void flush() override {}
+
+  void sync() override
+  {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = m_syncedOffset / pageSize * pageSize;
+    if (m_offset > begin && msync(m_data + begin, m_offset - begin, MS_SYNC) == 0)
+      m_syncedOffset = m_offset;
+  }
+
+private:
+  // Every page of the mapping has its blocks allocated before it is touched, so a full
+  // disk fails open() or grow() instead of raising SIGBUS inside a memcpy
+  bool map(size_t capacity)
+  {
+    if (!allocateFile(m_fd, capacity))
+      return false;
+
+    void *data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED)
+      return false;
+
+    m_data = static_cast<char *>(data);
+    m_capacity = capacity;
+    return true;
+  }
+
+  bool grow(size_t required)
+  {
+    size_t capacity = m_capacity;
+    while (capacity < required)
+      capacity += m_segmentSize;
+
+    // Map the larger range first so a failure leaves the current mapping usable
+    char *data = m_data;
+    size_t oldCapacity = m_capacity;
+    if (!map(capacity))
+      return false;
+
+    munmap(data, oldCapacity);
+    return true;
+  }
+
+  size_t m_segmentSize;
+  int m_fd = -1;
+  char *m_data = nullptr;
+  size_t m_capacity = 0;
+  size_t m_size = 0;
+  size_t m_offset = 0;
+  size_t m_syncedOffset = 0;
+};
+#endif
+
+#ifdef LOGGER_HAVE_IO_URING
+// Copies lines into registered buffers and submits each full (or flushed) buffer as one
+// write at an explicit offset, so writes may complete in any order. Only waits when every
+// buffer is in flight. Uses the raw syscalls; available() is false where the kernel or a
+// seccomp policy refuses io_uring_setup().
+class UringSink : public LogSink
+{
+public:
+  explicit UringSink(size_t preallocateSize)
+      : m_storage(new char[LOG_URING_BUFFER_COUNT * LOG_URING_BUFFER_SIZE]), m_preallocator(preallocateSize)
+  {
+    for (int i = LOG_URING_BUFFER_COUNT - 1; i >= 0; i--)
+    {
+      m_buffers[i].iov.iov_base = m_storage.get() + static_cast<size_t>(i) * LOG_URING_BUFFER_SIZE;
+      m_freeBuffers[m_freeCount++] = i;
+    }
+    setupRing();
+  }
+
+  ~UringSink() override
+  {
+    close();
+    teardownRing();
+  }
+
+  bool available() const { return m_ringFd >= 0; }
+
+  bool open(const std::string &path) override
+  {
+    // No O_APPEND: every write carries its own offset
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+      return false;
+
+    struct stat info;
+    m_size = fstat(m_fd, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    m_offset = m_size;
+    m_preallocator.reset(m_size);
+    m_preallocator.reserve(m_fd, m_offset + 1);
+    return true;
+  }
+
+  void close() override
+  {
+    if (m_fd >= 0)
+    {
+      flush();
+      waitForWrites();
+      m_preallocator.release(m_fd);
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  size_t size() const override { return m_size; }
+
+  bool write(const ByteSpan *spans, size_t count) override
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      const char *data = spans[i].data;
+      size_t length = spans[i].length;
+      while (length > 0)
+      {
+        if (m_current < 0)
+          m_current = acquireBuffer();
+
+        iovec &iov = m_buffers[m_current].iov;
+        size_t chunk = std::min(length, LOG_URING_BUFFER_SIZE - iov.iov_len);
+        std::memcpy(static_cast<char *>(iov.iov_base) + iov.iov_len, data, chunk);
+        iov.iov_len += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (iov.iov_len == LOG_URING_BUFFER_SIZE)
+          flush();
+      }
+    }
+    return !m_failed;
+  }
+
+  void flush() override
+  {
+    if (queueCurrent(0))
+      submit();
+  }
+
+  // The last buffer is linked to an fsync that also drains every earlier write, so
+  // the sync covers them all without the backend waiting for any of it
+  void sync() override
+  {
+    while (m_syncInFlight)
+      reap(true);
+
+    queueCurrent(IOSQE_IO_LINK);
+
+    io_uring_sqe &sqe = nextSqe();
+    sqe.opcode = IORING_OP_FSYNC;
+    sqe.flags = IOSQE_IO_DRAIN;
+    sqe.fd = m_fd;
+    sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe.user_data = SYNC_TAG;
+    publishSqe();
+
+    m_inFlight++;
+    m_syncInFlight = true;
+    submit();
+  }
+
+  void waitForWrites() override
+  {
+    while (m_inFlight > 0)
+      reap(true);
+  }
+
+private:
+  static constexpr uint64_t SYNC_TAG = LOG_URING_BUFFER_COUNT;
+
+  struct Buffer
+  {
+    iovec iov{};
+    uint64_t offset = 0;
+  };
+
+  // At most LOG_URING_BUFFER_COUNT writes and one fsync are in flight, so the ring always has room
+  io_uring_sqe &nextSqe()
+  {
+    io_uring_sqe &sqe = m_sqes[*m_sqTail & *m_sqMask];
+    std::memset(&sqe, 0, sizeof(sqe));
+    return sqe;
+  }
+
+  void publishSqe()
+  {
+    unsigned tail = *m_sqTail;
+    unsigned index = tail & *m_sqMask;
+    m_sqArray[index] = index;
+    std::atomic_ref<unsigned>(*m_sqTail).store(tail + 1, std::memory_order_release);
+    m_unsubmitted++;
+  }
+
+  // Hands every queued entry to the kernel. Entries it won't take (EAGAIN or EBUSY with
+  // nothing left to reap, ENOMEM, ...) are taken back out of the ring and carried out
+  // synchronously, so nothing is left waiting for a completion that will never come.
+  void submit()
+  {
+    while (m_unsubmitted > 0)
+    {
+      int result = enter(m_unsubmitted, 0, 0);
+      if (result > 0)
+      {
+        m_unsubmitted -= static_cast<unsigned>(result);
+        continue;
+      }
+
+      // Completions free kernel resources, if any of the submitted entries are outstanding
+      bool retry = result < 0 && (errno == EAGAIN || errno == EBUSY);
+      if (retry && m_inFlight > static_cast<int>(m_unsubmitted))
+      {
+        int outstanding = m_inFlight;
+        reap(true);
+        if (m_inFlight < outstanding)
+          continue;
+      }
+
+      withdrawUnsubmitted();
+    }
+  }
+
+  // Without SQPOLL the kernel only reads the ring inside io_uring_enter(), so unsubmitted
+  // entries can be taken back by moving the tail. They are redone in ring order.
+  void withdrawUnsubmitted()
+  {
+    unsigned tail = *m_sqTail - m_unsubmitted;
+    for (unsigned i = tail; i != *m_sqTail; i++)
+    {
+      const io_uring_sqe &sqe = m_sqes[i & *m_sqMask];
+      m_inFlight--;
+      if (sqe.user_data == SYNC_TAG)
+      {
+        if (syncData(m_fd) != 0)
+          m_failed = true;
+        m_syncInFlight = false;
+      }
+      else
+      {
+        completeWrite(static_cast<int>(sqe.user_data), 0);
+      }
+    }
+    std::atomic_ref<unsigned>(*m_sqTail).store(tail, std::memory_order_release);
+    m_unsubmitted = 0;
+  }
+
+  // Queues the partly filled buffer, if any, without entering the kernel
+  bool queueCurrent(uint8_t flags)
+  {
+    if (m_current < 0 || m_buffers[m_current].iov.iov_len == 0)
+      return false;
+
+    Buffer &buffer = m_buffers[m_current];
+    buffer.offset = m_offset;
+    m_offset += buffer.iov.iov_len;
+    m_preallocator.reserve(m_fd, m_offset);
+
+    io_uring_sqe &sqe = nextSqe();
+    sqe.flags = flags;
+    sqe.fd = m_fd;
+    sqe.off = buffer.offset;
+    sqe.user_data = static_cast<uint64_t>(m_current);
+    if (m_fixedBuffers)
+    {
+      sqe.opcode = IORING_OP_WRITE_FIXED;
+      sqe.addr = reinterpret_cast<uint64_t>(buffer.iov.iov_base);
+      sqe.len = static_cast<uint32_t>(buffer.iov.iov_len);
+      sqe.buf_index = static_cast<uint16_t>(m_current);
+    }
+    else
+    {
+      sqe.opcode = IORING_OP_WRITEV;
+      sqe.addr = reinterpret_cast<uint64_t>(&buffer.iov);
+      sqe.len = 1;
+    }
+    publishSqe();
+
+    m_inFlight++;
+    m_current = -1;
+    return true;
+  }
+
+  void setupRing()
+  {
+    io_uring_params params{};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, LOG_URING_BUFFER_COUNT + 1, &params));
+    if (fd < 0)
+      return;
+    m_ringFd = fd;
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+      m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+    m_cqRing = singleMmap ? m_sqRing
+                          : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+    if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || sqes == MAP_FAILED)
+    {
+      if (sqes != MAP_FAILED)
+        munmap(sqes, m_sqesSize);
+      teardownRing();
+      return;
+    }
+
+    char *sq = static_cast<char *>(m_sqRing);
+    char *cq = static_cast<char *>(m_cqRing);
+    m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_sqes = static_cast<io_uring_sqe *>(sqes);
+    m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // Registration pins the buffers; without it (e.g. RLIMIT_MEMLOCK) plain writev is used
+    iovec iov[LOG_URING_BUFFER_COUNT];
+    for (int i = 0; i < LOG_URING_BUFFER_COUNT; i++)
+    {
+      iov[i].iov_base = m_buffers[i].iov.iov_base;
+      iov[i].iov_len = LOG_URING_BUFFER_SIZE;
+    }
+    m_fixedBuffers = syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_BUFFERS, iov, LOG_URING_BUFFER_COUNT) == 0;
+  }
+
+  void teardownRing()
+  {
+    if (m_ringFd < 0)
+      return;
+
+    if (m_sqes != nullptr)
+      munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+      munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != MAP_FAILED)
+      munmap(m_sqRing, m_sqRingSize);
+    ::close(m_ringFd);
+    m_ringFd = -1;
+  }
+
+  int enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+  {
+    int result;
+    do
+    {
+      result = static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, nullptr, 0));
+    } while (result < 0 && errno == EINTR);
+    return result;
+  }
+
+  int acquireBuffer()
+  {
+    while (m_freeCount == 0)
+      reap(true);
+
+    int index = m_freeBuffers[--m_freeCount];
+    m_buffers[index].iov.iov_len = 0;
+    return index;
+  }
+
+  void reap(bool wait)
+  {
+    unsigned head = *m_cqHead;
+    if (wait && head == std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire))
+      enter(0, 1, IORING_ENTER_GETEVENTS);
+
+    unsigned tail = std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire);
+    for (; head != tail; head++)
+    {
+      const io_uring_cqe &cqe = m_cqes[head & *m_cqMask];
+      m_inFlight--;
+
+      if (cqe.user_data == SYNC_TAG)
+      {
+        // Cancelled because the linked write came up short, or failed: sync directly
+        if (cqe.res < 0 && syncData(m_fd) != 0)
+          m_failed = true;
+        m_syncInFlight = false;
+        continue;
+      }
+
+      completeWrite(static_cast<int>(cqe.user_data), cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0);
+    }
+    std::atomic_ref<unsigned>(*m_cqHead).store(head, std::memory_order_release);
+  }
+
+  // Finishes a short, failed or unsubmitted write synchronously and frees its buffer
+  void completeWrite(int index, size_t written)
+  {
+    Buffer &buffer = m_buffers[index];
+    while (written < buffer.iov.iov_len)
+    {
+      ssize_t result = pwrite(m_fd, static_cast<char *>(buffer.iov.iov_base) + written,
+                              buffer.iov.iov_len - written, static_cast<off_t>(buffer.offset + written));
+      if (result < 0 && errno == EINTR)
+        continue;
+      if (result <= 0)
+      {
+        m_failed = true;
+        break;
+      }
+      written += static_cast<size_t>(result);
+    }
+
+    m_freeBuffers[m_freeCount++] = index;
+  }
+
+  std::unique_ptr<char[]> m_storage;
+  Buffer m_buffers[LOG_URING_BUFFER_COUNT];
+  int m_freeBuffers[LOG_URING_BUFFER_COUNT];
+  int m_freeCount = 0;
+  int m_current = -1;
+  int m_inFlight = 0;
+  unsigned m_unsubmitted = 0; // Published to the ring but not yet taken by the kernel
+  bool m_fixedBuffers = false;
+  bool m_syncInFlight = false;
+  bool m_failed = false;
+
+  int m_fd = -1;
+  size_t m_size = 0;
+  uint64_t m_offset = 0;
+  Preallocator m_preallocator;
+
+  int m_ringFd = -1;
+  void *m_sqRing = MAP_FAILED;
+  void *m_cqRing = MAP_FAILED;
+  size_t m_sqRingSize = 0;
+  size_t m_cqRingSize = 0;
+  size_t m_sqesSize = 0;
+  unsigned *m_sqTail = nullptr;
+  unsigned *m_sqMask = nullptr;
+  unsigned *m_sqArray = nullptr;
+  io_uring_sqe *m_sqes = nullptr;
+  unsigned *m_cqHead = nullptr;
+  unsigned *m_cqTail = nullptr;
+  unsigned *m_cqMask = nullptr;
+  io_uring_cqe *m_cqes = nullptr;
+};
+#endif
+
+namespace
+{
+  // Writes value as exactly digits decimal digits, zero padded
+  void writeDigits(char *buffer, unsigned value, int digits)
+  {
+    for (int i = digits - 1; i >= 0; i--)
+    {
+      buffer[i] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    }
+  }
+
+  enum class ArgType : uint8_t
+  {
+    INT,
+    LONG,
+    LONG_LONG,
+    INTMAX,
+    SIZE,
+    PTRDIFF,
+    DOUBLE,
+    LONG_DOUBLE,
+    POINTER,
+    STRING
+  };
+
+  struct FormatSpec
+  {
+    const char *begin; // Points at the '%'
+    const char *end;   // One past the conversion character
+    bool widthStar;
+    bool precisionStar;
+    int precision; // Literal precision, -1 when absent or given by '*'
+    ArgType type;
+  };
+
+  // Parses the printf conversion at format[0] == '%'. Returns false for conversions
+  // whose arguments can't be captured by value (%n, wide characters, malformed specs).
+  bool parseFormatSpec(const char *format, FormatSpec &spec)
+  {
+    const char *p = format + 1;
+    spec.begin = format;
+    spec.widthStar = false;
+    spec.precisionStar = false;
+    spec.precision = -1;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'')
+      p++;
+
+    if (*p == '*')
+    {
+      spec.widthStar = true;
+      p++;
+    }
+    else
+    {
+      while (*p >= '0' && *p <= '9')
+        p++;
+    }
+
+    if (*p == '.')
+    {
+      p++;
+      if (*p == '*')
+      {
+        spec.precisionStar = true;
+        p++;
+      }
+      else
+      {
+        spec.precision = 0;
+        for (; *p >= '0' && *p <= '9'; p++)
+        {
+          // Anything this large exceeds every buffer anyway
+          if (spec.precision < INT_MAX / 10)
+            spec.precision = spec.precision * 10 + (*p - '0');
+        }
+      }
+    }
+
+    char length = 0;
+    bool doubled = false;
+    if (*p == 'h' || *p == 'l' || *p == 'j' || *p == 'z' || *p == 't' || *p == 'L')
+    {
+      length = *p++;
+      if ((length == 'h' || length == 'l') && *p == length)
+      {
+        doubled = true;
+        p++;
+      }
+    }
+
+    char conversion = *p;
+    if (conversion == '\0')
+      return false;
+    spec.end = p + 1;
+
+    switch (conversion)
+    {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      switch (length)
+      {
+      case 0:
+      case 'h':
+        spec.type = ArgType::INT;
+        return true;
+      case 'l':
+        spec.type = doubled ? ArgType::LONG_LONG : ArgType::LONG;
+        return true;
+      case 'j':
+        spec.type = ArgType::INTMAX;
+        return true;
+      case 'z':
+        spec.type = ArgType::SIZE;
+        return true;
+      case 't':
+        spec.type = ArgType::PTRDIFF;
+        return true;
+      default:
+        return false;
+      }
+    case 'c':
+      spec.type = ArgType::INT;
+      return length == 0;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      spec.type = length == 'L' ? ArgType::LONG_DOUBLE : ArgType::DOUBLE;
+      return length == 0 || length == 'L' || (length == 'l' && !doubled);
+    case 's':
+      spec.type = ArgType::STRING;
+      return length == 0;
+    case 'p':
+      spec.type = ArgType::POINTER;
+      return length == 0;
+    default:
+      return false;
+    }
+  }
+
+  class ArgWriter
+  {
+  public:
+    ArgWriter(char *buffer, size_t capacity) : m_buffer(buffer), m_capacity(capacity), m_used(0) {}
+
+    template <typename T>
+    bool put(T value)
+    {
+      if (m_used + sizeof(T) > m_capacity)
+        return false;
+      std::memcpy(m_buffer + m_used, &value, sizeof(T));
+      m_used += sizeof(T);
+      return true;
+    }
+
+    // Reads no further than precision bytes (when not negative), as printf would
+    bool putString(const char *value, int precision)
+    {
+      if (value == nullptr)
+        value = "(null)";
+      // A string that doesn't fit fails the capture rather than being cut
+      size_t limit = precision >= 0 ? std::min(static_cast<size_t>(precision), m_capacity) : m_capacity;
+      size_t length = strnlen(value, limit);
+      if (!put(static_cast<uint16_t>(length)) || m_used + length + 1 > m_capacity)
+        return false;
+      std::memcpy(m_buffer + m_used, value, length);
+      m_buffer[m_used + length] = '\0';
+      m_used += length + 1;
+      return true;
+    }
+
+    size_t used() const { return m_used; }
+
+  private:
+    char *m_buffer;
+    size_t m_capacity;
+    size_t m_used;
+  };
+
+  class ArgReader
+  {
+  public:
+    explicit ArgReader(const char *buffer) : m_buffer(buffer), m_used(0) {}
+
+    template <typename T>
+    T get()
+    {
+      T value;
+      std::memcpy(&value, m_buffer + m_used, sizeof(T));
+      m_used += sizeof(T);
+      return value;
+    }
+
+    const char *getString()
+    {
+      uint16_t length = get<uint16_t>();
+      const char *value = m_buffer + m_used;
+      m_used += length + 1u;
+      return value;
+    }
+
+  private:
+    const char *m_buffer;
+    size_t m_used;
+  };
+
+  // Copies the arguments described by format out of args, tagged by the conversion
+  // that will consume them. Returns false if any conversion can't be deferred.
+  bool captureArguments(const char *format, va_list args, char *buffer, size_t capacity, size_t &length)
+  {
+    ArgWriter writer(buffer, capacity);
+    va_list ap;
+    va_copy(ap, args);
+
+    bool captured = true;
+    const char *p = format;
+    while (captured && (p = std::strchr(p, '%')) != nullptr)
+    {
+      if (p[1] == '%')
+      {
+        p += 2;
+        continue;
+      }
+
+      FormatSpec spec;
+      if (!parseFormatSpec(p, spec))
+      {
+        captured = false;
+        break;
+      }
+
+      if (spec.widthStar)
+        captured = captured && writer.put(va_arg(ap, int));
+      int precision = spec.precision;
+      if (spec.precisionStar)
+      {
+        // A negative precision counts as none
+        precision = va_arg(ap, int);
+        captured = captured && writer.put(precision);
+      }
+
+      switch (spec.type)
+      {
+      case ArgType::INT:
+        captured = captured && writer.put(va_arg(ap, int));
+        break;
+      case ArgType::LONG:
+        captured = captured && writer.put(va_arg(ap, long));
+        break;
+      case ArgType::LONG_LONG:
+        captured = captured && writer.put(va_arg(ap, long long));
+        break;
+      case ArgType::INTMAX:
+        captured = captured && writer.put(va_arg(ap, intmax_t));
+        break;
+      case ArgType::SIZE:
+        captured = captured && writer.put(va_arg(ap, size_t));
+        break;
+      case ArgType::PTRDIFF:
+        captured = captured && writer.put(va_arg(ap, ptrdiff_t));
+        break;
+      case ArgType::DOUBLE:
+        captured = captured && writer.put(va_arg(ap, double));
+        break;
+      case ArgType::LONG_DOUBLE:
+        captured = captured && writer.put(va_arg(ap, long double));
+        break;
+      case ArgType::POINTER:
+        captured = captured && writer.put(va_arg(ap, void *));
+        break;
+      case ArgType::STRING:
+        captured = captured && writer.putString(va_arg(ap, const char *), precision);
+        break;
+      }
+
+      p = spec.end;
+    }
+
+    va_end(ap);
+    length = writer.used();
+    return captured;
+  }
+
+  template <typename T>
+  void appendFormatted(std::string &out, const char *spec, T value)
+  {
+    size_t offset = out.size();
+    out.resize(offset + BUFFER_SIZE);
+    int written = snprintf(&out[offset], BUFFER_SIZE, spec, value);
+    if (written >= BUFFER_SIZE)
+    {
+      out.resize(offset + written + 1);
+      snprintf(&out[offset], written + 1, spec, value);
+    }
+    out.resize(offset + std::max(written, 0));
+  }
+
+  // Replays format against arguments stored by captureArguments(), one snprintf per
+  // conversion, appending the message to out
+  void formatCapturedArguments(const char *format, const char *args, std::string &out)
+  {
+    ArgReader reader(args);
+
+    const char *p = format;
+    while (*p != '\0')
+    {
+      if (*p != '%')
+      {
+        const char *next = std::strchr(p, '%');
+        size_t length = next ? static_cast<size_t>(next - p) : std::strlen(p);
+        out.append(p, length);
+        p += length;
+        continue;
+      }
+
+      if (p[1] == '%')
+      {
+        out.push_back('%');
+        p += 2;
+        continue;
+      }
+
+      FormatSpec spec;
+      parseFormatSpec(p, spec);
+
+      // Rebuild the conversion with any '*' replaced by its captured value
+      char specText[64];
+      size_t specLength = 0;
+      for (const char *c = spec.begin; c != spec.end && specLength < sizeof(specText) - 12; c++)
+      {
+        if (*c == '*')
+          specLength += snprintf(specText + specLength, sizeof(specText) - specLength, "%d", reader.get<int>());
+        else
+          specText[specLength++] = *c;
+      }
+      specText[specLength] = '\0';
+
+      switch (spec.type)
+      {
+      case ArgType::INT:
+        appendFormatted(out, specText, reader.get<int>());
+        break;
+      case ArgType::LONG:
+        appendFormatted(out, specText, reader.get<long>());
+        break;
+      case ArgType::LONG_LONG:
+        appendFormatted(out, specText, reader.get<long long>());
+        break;
+      case ArgType::INTMAX:
+        appendFormatted(out, specText, reader.get<intmax_t>());
+        break;
+      case ArgType::SIZE:
+        appendFormatted(out, specText, reader.get<size_t>());
+        break;
+      case ArgType::PTRDIFF:
+        appendFormatted(out, specText, reader.get<ptrdiff_t>());
+        break;
+      case ArgType::DOUBLE:
+        appendFormatted(out, specText, reader.get<double>());
+        break;
+      case ArgType::LONG_DOUBLE:
+        appendFormatted(out, specText, reader.get<long double>());
+        break;
+      case ArgType::POINTER:
+        appendFormatted(out, specText, reader.get<void *>());
+        break;
+      case ArgType::STRING:
+        appendFormatted(out, specText, reader.getString());
+        break;
+      }
+
+      p = spec.end;
+    }
+  }
+
+#ifdef LOGGER_HAVE_ZLIB
+  bool gzipFile(const std::string &source, const std::string &target)
+  {
+    std::ifstream in(source, std::ios_base::binary);
+    gzFile out = gzopen(target.c_str(), "wb");
+    if (!in || out == nullptr)
+    {
+      if (out != nullptr)
+        gzclose(out);
+      return false;
+    }
+
+    char buffer[64 * 1024];
+    bool written = true;
+    while (written && in)
+    {
+      in.read(buffer, sizeof(buffer));
+      int length = static_cast<int>(in.gcount());
+      if (length > 0 && gzwrite(out, buffer, static_cast<unsigned>(length)) != length)
+        written = false;
+    }
+
+    return gzclose(out) == Z_OK && written && !in.bad();
+  }
+#endif
+
+#ifdef LOGGER_HAVE_ZSTD
+  bool zstdFile(const std::string &source, const std::string &target)
+  {
+    std::ifstream in(source, std::ios_base::binary);
+    std::ofstream out(target, std::ios_base::binary | std::ios_base::trunc);
+    ZSTD_CCtx *context = ZSTD_createCCtx();
+    if (!in || !out || context == nullptr)
+    {
+      ZSTD_freeCCtx(context);
+      return false;
+    }
+
+    std::vector<char> input(ZSTD_CStreamInSize());
+    std::vector<char> output(ZSTD_CStreamOutSize());
+    bool compressed = true;
+    bool last = false;
+    while (compressed && !last)
+    {
+      in.read(input.data(), static_cast<std::streamsize>(input.size()));
+      size_t length = static_cast<size_t>(in.gcount());
+      last = length < input.size();
+
+      ZSTD_inBuffer inBuffer{input.data(), length, 0};
+      bool finished = false;
+      while (!finished)
+      {
+        ZSTD_outBuffer outBuffer{output.data(), output.size(), 0};
+        size_t remaining = ZSTD_compressStream2(context, &outBuffer, &inBuffer, last ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining))
+        {
+          compressed = false;
+          break;
+        }
+        out.write(output.data(), static_cast<std::streamsize>(outBuffer.pos));
+        finished = last ? remaining == 0 : inBuffer.pos == inBuffer.size;
+      }
+    }
+
+    ZSTD_freeCCtx(context);
+    out.close();
+    return compressed && !in.bad() && !out.fail();
+  }
+#endif
+
+  std::tm calendarTime(std::time_t time, bool utc)
+  {
+    std::tm tm{};
+#ifdef _WIN32
+    utc ? gmtime_s(&tm, &time) : localtime_s(&tm, &time);
+#else
+    utc ? gmtime_r(&time, &tm) : localtime_r(&time, &tm);
+#endif
+    return tm;
+  }
+
+  struct ProducerHandle
+  {
+    std::shared_ptr<SpscQueue> queue;
+
+    ~ProducerHandle()
+    {
+      if (queue)
+        queue->markProducerExited();
+    }
+  };
+}
+
+Logger::Logger()
+    : m_currentLevel(LogLevel::INFO),
+      m_consoleOutput(true),
+      m_initialized(false),
+      m_logFilePath(LOG_FILE_PATH),
+      m_maxFileSize(MAX_FILE_SIZE),
+      m_sinkType(SinkType::FD),
+      m_preallocateSize(0),
+      m_fileOpen(false),
+      m_bufferedCount(0),
+      m_lastFlushTime(std::chrono::steady_clock::now()),
+      m_durability(DurabilityMode::NONE),
+      m_syncIntervalMs(LOG_SYNC_INTERVAL_MS),
+      m_syncIntervalBytes(LOG_SYNC_INTERVAL_BYTES),
+      m_unsyncedBytes(0),
+      m_lastSyncTime(std::chrono::steady_clock::now()),
+      m_asyncMode(false),
+      m_queueCapacity(LOG_QUEUE_CAPACITY),
+      m_overflowPolicy(OverflowPolicy::BLOCK),
+      m_deferredFormatting(false),
+      m_clockSource(ClockSource::SYSTEM),
+      m_timestampPrecision(TimestampPrecision::MILLISECONDS),
+      m_utcTimestamps(false),
+      m_droppedCount(0),
+      m_partialChunks(0),
+      m_backendSleeping(false),
+      m_drainWaiters(0),
+      m_stopBackend(false),
+      m_nextSinkFailed(false),
+      m_rotationPending(false),
+      m_stopMaintenance(false),
+      m_rotationRolledBack(false),
+      m_rotationInterval(RotationInterval::NONE),
+      m_nextRotationTime(std::chrono::steady_clock::time_point::max()),
+      m_archiveNaming(ArchiveNaming::BACKUP),
+      m_maxArchiveFiles(LOG_MAX_ARCHIVE_FILES),
+      m_maxArchiveBytes(0),
+      m_archiveBytes(0),
+      m_nextArchiveNumber(1),
+      m_archiveStampCount(0),
+      m_compression(Compression::NONE),
+      m_stopCompression(false)
+{
+}
+
+bool Logger::init(const char *logFilePath, LogLevel level, bool consoleOutput, size_t maxFileSize)
+{
+  LoggerConfig config;
+  config.logFilePath = logFilePath;
+  config.level = level;
+  config.consoleOutput = consoleOutput;
+  config.maxFileSize = maxFileSize;
+  return init(config);
+}
+
+bool Logger::init(const LoggerConfig &config)
+{
+  if (m_initialized.load(std::memory_order_acquire))
+  {
+    return true;
+  }
+
+  m_logFilePath = config.logFilePath;
+  m_currentLevel.store(config.level, std::memory_order_relaxed);
+  m_consoleOutput.store(config.consoleOutput, std::memory_order_relaxed);
+  m_maxFileSize = config.maxFileSize;
+  m_asyncMode = config.asyncMode;
+  m_queueCapacity = std::bit_ceil(std::max<size_t>(config.queueCapacity, 2));
+  m_overflowPolicy = config.overflowPolicy;
+  m_deferredFormatting = config.asyncMode && config.deferredFormatting;
+  m_clockSource = config.clockSource;
+  m_timestampPrecision = config.timestampPrecision;
+  m_utcTimestamps = config.utcTimestamps;
+  m_sinkType = config.sink;
+  m_preallocateSize = config.preallocateSize;
+  m_rotationInterval = config.rotationInterval;
+  // Archives are named after the period they cover
+  m_archiveNaming = m_rotationInterval != RotationInterval::NONE ? ArchiveNaming::TIMESTAMPED : config.archiveNaming;
+  m_maxArchiveFiles = config.maxArchiveFiles;
+  m_maxArchiveBytes = config.maxArchiveBytes;
+  m_compression = config.compression;
+#ifndef LOGGER_HAVE_ZSTD
+  if (m_compression == Compression::ZSTD)
+    m_compression = Compression::GZIP;
+#endif
+#ifndef LOGGER_HAVE_ZLIB
+  if (m_compression == Compression::GZIP)
+    m_compression = Compression::NONE;
+#endif
+  m_durability = config.durability;
+  m_syncIntervalMs = config.syncIntervalMs;
+  m_syncIntervalBytes = config.syncIntervalBytes;
+  m_messageBuffer.reserve(LOG_BUFFER_BYTES);
+
+  if (!createLogDirectory(m_logFilePath))
+  {
+    std::cerr << "Failed to create log directory for: " << m_logFilePath << "\n";
+    return false;
+  }
+
+  if (!openLogFile())
+  {
+    std::cerr << "Failed to initialize logger file: " << m_logFilePath << "\n";
+    return false;
+  }
+
+  char timestampBuffer[64];
+  getTimestamp(timestampBuffer, sizeof(timestampBuffer));
+
+  std::string initMessage = "[" + std::string(timestampBuffer) + "] [INFO] Logger initialized\n";
+  ByteSpan span{initMessage.data(), initMessage.size()};
+  m_sink->write(&span, 1);
+  m_currentFileSize += initMessage.size();
+  m_sink->flush();
+
+  if (m_rotationInterval != RotationInterval::NONE)
+  {
+    schedulePeriodRotation();
+  }
+
+  recoverArchives();
+
+  if (m_archiveNaming != ArchiveNaming::BACKUP)
+  {
+    loadArchives();
+  }
+
+  if (m_compression != Compression::NONE)
+  {
+    startCompression(config.compressionThreads);
+  }
+
+#ifndef _WIN32
+  startMaintenance();
+#endif
+
+  if (m_asyncMode)
+  {
+    startBackend();
+  }
+
+  // Publishes the file and configuration to threads that see m_initialized set
+  m_initialized.store(true, std::memory_order_release);
+  return true;
+}
+
+Logger::~Logger()
+{
+  if (m_initialized.load(std::memory_order_acquire))
+  {
+    if (m_asyncMode)
+    {
+      stopBackend();
+    }
+
+    char timestampBuffer[TIME_STAMP_BUFFER];
+    getTimestamp(timestampBuffer, TIME_STAMP_BUFFER);
+
+    flushBuffer();
+    waitForRotation();
+
+    std::string shutdownMsg = "[" + std::string(timestampBuffer) + "] [INFO] Logger shutdown\n";
+    if (m_fileOpen)
+    {
+      ByteSpan span{shutdownMsg.data(), shutdownMsg.size()};
+      m_sink->write(&span, 1);
+      m_sink->flush();
+    }
+
+    closeLogFile();
+    stopMaintenance();
+    stopCompression();
+  }
+}
+
+void Logger::error(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vlog(LogLevel::ERR, format, args);
+  va_end(args);
+}
+
+void Logger::warning(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vlog(LogLevel::WARNING, format, args);
+  va_end(args);
+}
+
+void Logger::info(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vlog(LogLevel::INFO, format, args);
+  va_end(args);
+}
+
+void Logger::debug(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vlog(LogLevel::DEBUG, format, args);
+  va_end(args);
+}
+
+void Logger::log(LogLevel level, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vlog(level, format, args);
+  va_end(args);
+}
+
+void Logger::vlog(LogLevel level, const char *format, va_list args)
+{
+  if (!isEnabled(level) || !m_initialized.load(std::memory_order_acquire))
+  {
+    return;
+  }
+
+  if (m_deferredFormatting)
+  {
+    enqueueDeferred(level, format, args);
+    return;
+  }
+
+  submitEntry(level, [&](char *buffer, size_t bufferSize)
+              { return formatMessage(buffer, bufferSize, format, args); });
+}
+
+void Logger::writeMessage(LogLevel level, const char *message, size_t length)
+{
+  submitEntry(level, [&](char *buffer, size_t bufferSize)
+              {
+    std::memcpy(buffer, message, std::min(length, bufferSize - 1));
+    return length; });
+}
+
+// formatEntry(buffer, bufferSize) follows vsnprintf: it writes at most bufferSize - 1
+// characters and returns the full message length. Messages that fit are built on the
+// stack; longer ones are formatted again into a per-thread buffer that keeps its capacity.
+template <typename FormatEntry>
+void Logger::submitEntry(LogLevel level, FormatEntry &&formatEntry)
+{
+  thread_local std::vector<char> longBuffer;
+
+  if (m_asyncMode)
+  {
+    uint64_t ticks = TickClock::now();
+    char message[LOG_RECORD_SIZE];
+    size_t length = formatEntry(message, sizeof(message));
+
+    if (length < sizeof(message))
+    {
+      enqueueMessage(level, ticks, message, length);
+      return;
+    }
+
+    longBuffer.resize(length + 1);
+    formatEntry(longBuffer.data(), longBuffer.size());
+    enqueueMessage(level, ticks, longBuffer.data(), length);
+    return;
+  }
+
+  char logEntry[LOG_LINE_SIZE];
+  size_t prefixLength = formatPrefix(logEntry, currentTime(), level);
+  size_t messageSize = sizeof(logEntry) - prefixLength - 1;
+  size_t length = formatEntry(logEntry + prefixLength, messageSize);
+  char *line = logEntry;
+
+  if (length >= messageSize)
+  {
+    longBuffer.resize(prefixLength + length + 2);
+    std::memcpy(longBuffer.data(), logEntry, prefixLength);
+    formatEntry(longBuffer.data() + prefixLength, length + 1);
+    line = longBuffer.data();
+  }
+
+  line[prefixLength + length] = '\n';
+
+  lockMutex();
+  writeEntry(level, line, prefixLength + length + 1);
+  unlockMutex();
+}
+
+// Writes "[timestamp] [LEVEL] " into buffer, which must hold at least LOG_LINE_SIZE bytes
+size_t Logger::formatPrefix(char *buffer, std::chrono::system_clock::time_point time, LogLevel level)
+{
+  size_t used = 0;
+  buffer[used++] = '[';
+  getTimestamp(time, buffer + used, TIME_STAMP_BUFFER);
+  used += std::strlen(buffer + used);
+  std::memcpy(buffer + used, "] [", 3);
+  used += 3;
+  std::memcpy(buffer + used, logLevelToString(level), 5);
+  used += 5;
+  std::memcpy(buffer + used, "] ", 2);
+  used += 2;
+  return used;
+}
+
+// Returns the full length of the message, which may be longer than what fit in buffer
+size_t Logger::formatMessage(char *buffer, size_t bufferSize, const char *format, va_list args)
+{
+  va_list argsCopy;
+  va_copy(argsCopy, args);
+  int written = vsnprintf(buffer, bufferSize, format, argsCopy);
+  va_end(argsCopy);
+
+  return written > 0 ? static_cast<size_t>(written) : 0;
+}
+
+void Logger::writeEntry(LogLevel level, const char *entry, size_t length)
+{
+  if (m_consoleOutput.load(std::memory_order_relaxed))
+  {
+    std::cout.write(entry, static_cast<std::streamsize>(length));
+  }
+
+  if (!m_fileOpen && !openLogFile()) [[unlikely]]
+  {
+    return;
+  }
+
+  if (m_rotationRolledBack.load(std::memory_order_acquire)) [[unlikely]]
+  {
+    rollBackRotation();
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  checkRotation(length, now);
+
+  m_currentFileSize += length;
+  m_unsyncedBytes += length;
+
+  // Never let the arena reallocate: a line that doesn't fit goes out together with it
+  if (m_messageBuffer.size() + length > m_messageBuffer.capacity())
+  {
+    ByteSpan spans[] = {{m_messageBuffer.data(), m_messageBuffer.size()}, {entry, length}};
+    m_sink->write(spans, 2);
+    m_sink->flush();
+    m_messageBuffer.clear();
+    m_bufferedCount = 0;
+    m_lastFlushTime = now;
+  }
+  else
+  {
+    m_messageBuffer.insert(m_messageBuffer.end(), entry, entry + length);
+    m_bufferedCount++;
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastFlushTime).count();
+    if (m_bufferedCount >= LOG_BUFFER_CAPACITY || m_messageBuffer.size() >= LOG_BUFFER_BYTES ||
+        elapsedMs >= FLUSH_INTERVAL_MS)
+    {
+      flushBuffer();
+    }
+  }
+
+  if (m_durability == DurabilityMode::ON_ERROR && level == LogLevel::ERR)
+  {
+    flushBuffer();
+    syncLogFile(true);
+  }
+  else if (m_durability == DurabilityMode::PERIODIC &&
+           ((m_syncIntervalBytes > 0 && m_unsyncedBytes >= m_syncIntervalBytes) ||
+            (m_syncIntervalMs > 0 && now - m_lastSyncTime >= std::chrono::milliseconds(m_syncIntervalMs))))
+  {
+    flushBuffer();
+    syncLogFile(false);
+  }
+}
+
+void Logger::enqueueDeferred(LogLevel level, const char *format, va_list args)
 {
-  static Logger instance;
-  return instance;
+  char captured[LOG_RECORD_SIZE];
+  size_t length = 0;
+
+  if (!captureArguments(format, args, captured, sizeof(captured), length))
+  {
+    // Conversion we can't defer, or arguments too large for a slot: format the message here instead
+    submitEntry(level, [&](char *buffer, size_t bufferSize)
+                { return formatMessage(buffer, bufferSize, format, args); });
+    return;
+  }
+
+  uint64_t ticks = TickClock::now();
+  SpscQueue &queue = producerQueue();
+  if (!reserveRecords(queue, 1))
+    return;
+
+  LogRecord &record = queue.slot(0);
+  record.level = level;
+  record.format = format;
+  record.ticks = ticks;
+  record.chunk = 0;
+  record.chunkCount = 1;
+  record.length = static_cast<uint32_t>(length);
+  std::memcpy(record.text, captured, length);
+
+  commitRecords(queue, 1);
 }
 
-Logger::Logger()
-    : m_currentLevel(LogLevel::INFO),
-      m_logFilePath(LOG_FILE_PATH),
-      m_maxFileSize(MAX_FILE_SIZE),
-      m_initialized(false),
-      m_consoleOutput(true),
-      m_lastFlushTime(std::chrono::steady_clock::now())
+// Splits the message over as many slots as it needs. They are committed together,
+// so the backend never sees part of a message without the rest.
+void Logger::enqueueMessage(LogLevel level, uint64_t ticks, const char *message, size_t length)
 {
+  SpscQueue &queue = producerQueue();
+  constexpr size_t chunkSize = sizeof(LogRecord::text);
+
+  size_t count = std::max<size_t>(1, (length + chunkSize - 1) / chunkSize);
+  if (count > queue.capacity()) [[unlikely]]
+  {
+    writeOversized(queue, level, message, length);
+    return;
+  }
+
+  if (!reserveRecords(queue, count))
+    return;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    LogRecord &record = queue.slot(i);
+    size_t offset = i * chunkSize;
+    size_t chunkLength = std::min(chunkSize, length - offset);
+
+    record.level = level;
+    record.format = nullptr;
+    record.ticks = ticks;
+    record.chunk = static_cast<uint32_t>(i);
+    record.chunkCount = static_cast<uint32_t>(count);
+    record.length = static_cast<uint32_t>(chunkLength);
+    std::memcpy(record.text, message + offset, chunkLength);
+  }
+
+  commitRecords(queue, count);
 }
 
-bool Logger::init(const char *logFilePath, LogLevel level, bool consoleOutput, size_t maxFileSize)
+// Applies the overflow policy. Under OVERWRITE_OLDEST the queue stays locked until commitRecords().
+bool Logger::reserveRecords(SpscQueue &queue, size_t count)
+{
+  if (m_overflowPolicy == OverflowPolicy::OVERWRITE_OLDEST)
+  {
+    queue.lock();
+    while (!queue.reserve(count))
+    {
+      // Count each discarded message once, by its first slot
+      if (queue.oldest().chunk == 0)
+        m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+      queue.pop();
+    }
+    return true;
+  }
+
+  if (queue.reserve(count))
+    return true;
+
+  if (m_overflowPolicy == OverflowPolicy::DROP_NEWEST)
+  {
+    m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Sleep until the backend has drained something; the timeout only guards against a
+  // backend that is stopping
+  m_drainWaiters.fetch_add(1, std::memory_order_seq_cst);
+  std::unique_lock<std::mutex> queueLock(m_queueMutex);
+  m_queueCv.notify_one();
+  while (!queue.reserve(count))
+  {
+    m_drainedCv.wait_for(queueLock, std::chrono::milliseconds(10));
+  }
+  queueLock.unlock();
+  m_drainWaiters.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+// A message larger than the whole queue is written by the calling thread, stamped with the
+// time it is written as in synchronous mode. It first waits until the backend has written
+// what this thread queued earlier, so the message keeps its place among them.
+void Logger::writeOversized(SpscQueue &queue, LogLevel level, const char *message, size_t length)
+{
+  if (!queue.empty())
+  {
+    m_drainWaiters.fetch_add(1, std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> queueLock(m_queueMutex);
+    m_queueCv.notify_one();
+    while (!queue.empty())
+    {
+      m_drainedCv.wait_for(queueLock, std::chrono::milliseconds(10));
+    }
+    queueLock.unlock();
+    m_drainWaiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // The backend pops records under the log mutex, so the last of them is written by now
+  lockMutex();
+  char prefix[LOG_LINE_SIZE];
+  size_t prefixLength = formatPrefix(prefix, currentTime(), level);
+  m_lineBuffer.assign(prefix, prefixLength);
+  m_lineBuffer.append(message, length);
+  m_lineBuffer.push_back('\n');
+  writeEntry(level, m_lineBuffer.data(), m_lineBuffer.size());
+  unlockMutex();
+}
+
+void Logger::commitRecords(SpscQueue &queue, size_t count)
+{
+  queue.commit(count);
+
+  if (m_overflowPolicy == OverflowPolicy::OVERWRITE_OLDEST)
+  {
+    queue.unlock();
+  }
+
+  if (m_backendSleeping.load(std::memory_order_seq_cst))
+  {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_queueCv.notify_one();
+  }
+}
+
+void Logger::writeRecord(const LogRecord &record)
+{
+  const char *message = record.text;
+  size_t messageLength = record.length;
+
+  if (record.chunkCount > 1)
+  {
+    if (record.chunk == 0)
+    {
+      m_partialMessage.assign(record.text, record.length);
+    }
+    else if (record.chunk == m_partialChunks)
+    {
+      m_partialMessage.append(record.text, record.length);
+    }
+    else
+    {
+      return; // The start of this message was overwritten
+    }
+
+    m_partialChunks = record.chunk + 1;
+    if (m_partialChunks < record.chunkCount)
+      return;
+
+    m_partialChunks = 0;
+    message = m_partialMessage.data();
+    messageLength = m_partialMessage.size();
+  }
+
+  char prefix[LOG_LINE_SIZE];
+  size_t prefixLength = formatPrefix(prefix, m_tickClock->toTime(record.ticks), record.level);
+  m_lineBuffer.assign(prefix, prefixLength);
+
+  if (record.format != nullptr)
+    formatCapturedArguments(record.format, record.text, m_lineBuffer);
+  else
+    m_lineBuffer.append(message, messageLength);
+
+  m_lineBuffer.push_back('\n');
+  writeEntry(record.level, m_lineBuffer.data(), m_lineBuffer.size());
+}
+
+SpscQueue &Logger::producerQueue()
+{
+  thread_local ProducerHandle handle;
+
+  if (!handle.queue)
+  {
+    handle.queue = std::make_shared<SpscQueue>(m_queueCapacity);
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    m_producerQueues.push_back(handle.queue);
+  }
+
+  return *handle.queue;
+}
+
+bool Logger::hasPendingRecords()
+{
+  std::lock_guard<std::mutex> lock(m_registryMutex);
+  for (const auto &queue : m_producerQueues)
+  {
+    if (!queue->empty())
+      return true;
+  }
+  return false;
+}
+
+size_t Logger::drainQueues()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    std::erase_if(m_producerQueues, [](const std::shared_ptr<SpscQueue> &queue)
+                  { return queue->producerExited() && queue->empty(); });
+    m_drainList.assign(m_producerQueues.begin(), m_producerQueues.end());
+  }
+
+  size_t drained = 0;
+
+  lockMutex();
+  for (const auto &queue : m_drainList)
+  {
+    // A message is committed to one queue in one go, so reassembly never continues into
+    // another queue; a message cut short by overwrites mustn't absorb another queue's chunks
+    m_partialChunks = 0;
+
+    if (m_overflowPolicy == OverflowPolicy::OVERWRITE_OLDEST)
+    {
+      // Copy out under the queue lock so the producer can't overwrite the slot mid-write
+      LogRecord record;
+      while (true)
+      {
+        queue->lock();
+        LogRecord *front = queue->front();
+        if (front == nullptr)
+        {
+          queue->unlock();
+          break;
+        }
+        record = *front;
+        queue->pop();
+        queue->unlock();
+
+        writeRecord(record);
+        drained++;
+      }
+      continue;
+    }
+
+    while (LogRecord *record = queue->front())
+    {
+      writeRecord(*record);
+      queue->pop();
+      drained++;
+    }
+  }
+  unlockMutex();
+
+  m_drainList.clear();
+
+  if (drained > 0 && m_drainWaiters.load(std::memory_order_seq_cst) > 0)
+  {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_drainedCv.notify_all();
+  }
+
+  return drained;
+}
+
+void Logger::startBackend()
+{
+  m_stopBackend = false;
+  m_tickClock = std::make_unique<TickClock>();
+  m_backendThread = std::thread(&Logger::backendLoop, this);
+}
+
+void Logger::stopBackend()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_stopBackend = true;
+  }
+  m_queueCv.notify_one();
+
+  if (m_backendThread.joinable())
+    m_backendThread.join();
+}
+
+void Logger::backendLoop()
+{
+  // Measure the tick rate before converting anything; records logged meanwhile just wait
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  m_tickClock->synchronize();
+  auto lastClockSync = std::chrono::steady_clock::now();
+
+  unsigned idleTimeoutMs = FLUSH_INTERVAL_MS;
+  if (m_durability == DurabilityMode::PERIODIC && m_syncIntervalMs > 0)
+    idleTimeoutMs = std::min(idleTimeoutMs, m_syncIntervalMs);
+
+  while (true)
+  {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastClockSync >= std::chrono::milliseconds(CLOCK_SYNC_INTERVAL_MS))
+    {
+      m_tickClock->synchronize();
+      lastClockSync = now;
+    }
+
+    if (drainQueues() > 0)
+      continue;
+
+    std::unique_lock<std::mutex> queueLock(m_queueMutex);
+    if (m_stopBackend)
+      break;
+
+    // Producers check this flag after publishing, so a record committed
+    // before we go to sleep is either seen here or wakes us up
+    m_backendSleeping.store(true, std::memory_order_seq_cst);
+    bool woken = m_queueCv.wait_for(queueLock, std::chrono::milliseconds(idleTimeoutMs),
+                                    [this]
+                                    { return m_stopBackend || hasPendingRecords(); });
+    m_backendSleeping.store(false, std::memory_order_relaxed);
+    queueLock.unlock();
+
+    if (!woken)
+    {
+      lockMutex();
+      flushBuffer(); // Idle: push out whatever the interval check left behind
+      if (m_durability == DurabilityMode::PERIODIC && m_unsyncedBytes > 0 && m_fileOpen)
+        syncLogFile(false);
+      unlockMutex();
+    }
+  }
+
+  drainQueues();
+}
+
+void Logger::lockMutex()
+{
+  static_cast<std::mutex *>(&m_logMutex)->lock();
+}
+
+void Logger::unlockMutex()
+{
+  static_cast<std::mutex *>(&m_logMutex)->unlock();
+}
+
+bool Logger::validateLogPath(const std::string &path)
+{
+  if (path.find("..") != std::string::npos)
+    return false; // Potential directory traversal
+
+  return true;
+}
+
+// Runs on init, rotation and after a failed open only; the directory was checked by
+// createLogDirectory() beforehand, so this makes no metadata calls of its own
+std::unique_ptr<LogSink> Logger::createSink() const
+{
+#ifdef LOGGER_HAVE_IO_URING
+  if (m_sinkType == SinkType::IO_URING)
+  {
+    auto sink = std::make_unique<UringSink>(m_preallocateSize);
+    if (sink->available())
+      return sink;
+  }
+#endif
+#ifndef _WIN32
+  if (m_sinkType == SinkType::MMAP)
+    return std::make_unique<MmapSink>(m_maxFileSize);
+  if (m_sinkType != SinkType::STREAM)
+    return std::make_unique<FdSink>(m_preallocateSize);
+#endif
+  return std::make_unique<StreamSink>();
+}
+
+bool Logger::openLogFile()
+{
+  if (m_fileOpen)
+  {
+    return true;
+  }
+
+  if (!m_sink)
+  {
+    m_sink = createSink();
+  }
+
+  if (!m_sink->open(m_logFilePath))
+    return false;
+
+  m_currentFileSize = m_sink->size();
+  m_fileOpen = true;
+  return true;
+}
+
+void Logger::closeLogFile()
+{
+  if (m_sink)
+    m_sink->close();
+  m_fileOpen = false;
+}
+
+void Logger::flushBuffer()
+{
+  if (!m_sink)
+    return;
+
+  if (!m_messageBuffer.empty())
+  {
+    ByteSpan span{m_messageBuffer.data(), m_messageBuffer.size()};
+    m_sink->write(&span, 1);
+    m_messageBuffer.clear();
+  }
+
+  m_sink->flush();
+  m_bufferedCount = 0;
+  m_lastFlushTime = std::chrono::steady_clock::now();
+}
+
+// With wait false a sink may only start the sync (io_uring); it still completes in order
+void Logger::syncLogFile(bool wait)
+{
+  m_sink->sync();
+  if (wait)
+    m_sink->waitForWrites();
+
+  m_unsyncedBytes = 0;
+  m_lastSyncTime = std::chrono::steady_clock::now();
+}
+
+void Logger::flush()
+{
+  if (m_asyncMode && m_backendThread.joinable())
+  {
+    std::vector<std::pair<std::shared_ptr<SpscQueue>, size_t>> targets;
+    {
+      std::lock_guard<std::mutex> lock(m_registryMutex);
+      for (const auto &queue : m_producerQueues)
+      {
+        targets.emplace_back(queue, queue->tail());
+      }
+    }
+
+    m_drainWaiters.fetch_add(1, std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> queueLock(m_queueMutex);
+    m_queueCv.notify_one();
+    m_drainedCv.wait(queueLock, [&targets]
+                     {
+      for (const auto &[queue, tail] : targets)
+      {
+        if (queue->head() < tail)
+          return false;
+      }
+      return true; });
+    queueLock.unlock();
+    m_drainWaiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  lockMutex();
+  flushBuffer();
+  if (m_sink)
+    m_sink->waitForWrites();
+  unlockMutex();
+
+  waitForRotation();
+}
+
+// Lines written before a rotation are only under their final name once it completes, or
+// once a failed one is rolled back
+void Logger::waitForRotation()
+{
+  std::unique_lock<std::mutex> lock(m_maintenanceMutex);
+  m_maintenanceDoneCv.wait(lock, [this]
+                           { return !m_rotationPending; });
+  lock.unlock();
+
+  if (m_rotationRolledBack.load(std::memory_order_acquire))
+  {
+    lockMutex();
+    rollBackRotation();
+    unlockMutex();
+  }
+}
+
+// Undoes a switch whose archive couldn't be created: the old file becomes current again, as
+// it would have without background rotation, and the lines written to the next file in the
+// meantime are moved over in order. Called with the log mutex held.
+void Logger::rollBackRotation()
+{
+  std::unique_ptr<LogSink> restored;
+  {
+    std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+    restored = std::move(m_restoredSink);
+  }
+  if (!restored)
+    return;
+
+  flushBuffer();
+  m_sink->close();
+  m_sink = std::move(restored);
+
+  std::string nextPath = m_logFilePath + LOG_NEXT_FILE_SUFFIX;
+  std::ifstream next(nextPath, std::ios_base::binary);
+  std::vector<char> chunk(LOG_BUFFER_BYTES);
+  while (next.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || next.gcount() > 0)
+  {
+    ByteSpan span{chunk.data(), static_cast<size_t>(next.gcount())};
+    m_sink->write(&span, 1);
+    m_unsyncedBytes += span.length;
+  }
+  next.close();
+
+  std::error_code ec;
+  std::filesystem::remove(nextPath, ec);
+  m_currentFileSize = 0;
+
+  // Only now may the maintenance thread prepare a new next file
+  std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+  m_rotationRolledBack.store(false, std::memory_order_relaxed);
+  m_maintenanceCv.notify_one();
+}
+
+uint64_t Logger::droppedCount() const
+{
+  return m_droppedCount.load(std::memory_order_relaxed);
+}
+
+bool Logger::createLogDirectory(const std::string &filePath)
 {
-  if (m_initialized)
+  std::filesystem::path path(filePath);
+  std::filesystem::path dir = path.parent_path();
+
+  if (dir.empty())
   {
     return true;
   }
 
-  m_logFilePath = logFilePath;
-  m_currentLevel = level;
-  m_consoleOutput = consoleOutput;
-  m_maxFileSize = maxFileSize;
-  m_messageBuffer.reserve(LOG_BUFFER_CAPACITY);
+  try
+  {
+    // One stat in the usual case where the directory is there
+    if (std::filesystem::is_directory(dir))
+    {
+      return true;
+    }
+
+    if (std::filesystem::exists(dir))
+    {
+      std::cerr << "Log path is not a directory: '" << dir << "'\n";
+      return false;
+    }
 
-  if (!createLogDirectory(m_logFilePath))
+    return std::filesystem::create_directories(dir);
+  }
+  catch (const std::filesystem::filesystem_error &e)
   {
-    std::cerr << "Failed to create log directory for: " << m_logFilePath << "\n";
+    std::cerr << "Error creating directory: " << e.what() << std::endl;
     return false;
   }
+}
 
-  if (!openLogFile())
+// Gives the log file its archive name. On failure the file keeps its name and the
+// logger goes on appending to it, as before the rotation.
+bool Logger::rotateLogFile(const std::string &archivePath)
+{
+  std::error_code ec;
+  // Replaces an existing .bak
+  std::filesystem::rename(m_logFilePath, archivePath, ec);
+  if (ec)
   {
-    std::cerr << "Failed to initialize logger file: " << m_logFilePath << "\n";
+    std::cerr << "Failed to rename log file: " << ec.message() << "\n";
     return false;
   }
+  return true;
+}
 
-  m_currentFileSize = static_cast<size_t>(m_logFile.tellp());
-
-  char timestampBuffer[64];
-  getTimestamp(timestampBuffer, sizeof(timestampBuffer));
+// Records a closed archive for retention and compression. Runs on the maintenance thread,
+// or inline when no next file is ready; never both at once.
+void Logger::addArchive(const std::string &archivePath)
+{
+  std::error_code ec;
+  uint64_t size = std::filesystem::file_size(archivePath, ec);
+  if (ec)
+    size = 0;
 
-  std::string initMessage = "[" + std::string(timestampBuffer) + "] [INFO] Logger initialized\n";
-  m_logFile << initMessage;
-  m_currentFileSize += initMessage.size();
-  m_logFile.flush();
+  if (m_archiveNaming != ArchiveNaming::BACKUP)
+  {
+    std::lock_guard<std::mutex> lock(m_archiveMutex);
+    m_archives.push_back({archivePath, size});
+    m_archiveBytes += size;
+    enforceRetention();
+  }
 
-  m_initialized = true;
-  return true;
+  if (m_compression != Compression::NONE)
+  {
+    std::lock_guard<std::mutex> lock(m_compressionMutex);
+    m_compressionQueue.push_back(archivePath);
+    m_compressionCv.notify_one();
+  }
 }
 
-Logger::~Logger()
+// Works out the current period's name and when it ends. The deadline is kept on the
+// steady clock the per-line check already reads; it is recomputed every period.
+void Logger::schedulePeriodRotation()
 {
-  if (m_initialized)
-  {
-    char timestampBuffer[TIME_STAMP_BUFFER];
-    getTimestamp(timestampBuffer, TIME_STAMP_BUFFER);
+  auto now = std::chrono::system_clock::now();
+  std::time_t time = std::chrono::system_clock::to_time_t(now);
+  std::tm tm = calendarTime(time, m_utcTimestamps);
 
-    flushBuffer();
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  if (m_rotationInterval == RotationInterval::DAILY)
+    tm.tm_hour = 0;
 
-    std::string shutdownMsg = "[" + std::string(timestampBuffer) + "] [INFO] Logger shutdown\n";
-    m_logFile << shutdownMsg;
-    m_logFile.flush();
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), m_rotationInterval == RotationInterval::DAILY ? "%Y%m%d" : "%Y%m%d-%H", &tm);
+  m_periodStamp = stamp;
 
-    closeLogFile();
-  }
+  if (m_rotationInterval == RotationInterval::DAILY)
+    tm.tm_mday++;
+  else
+    tm.tm_hour++;
+  tm.tm_isdst = -1;
+
+#ifdef _WIN32
+  std::time_t end = m_utcTimestamps ? _mkgmtime(&tm) : std::mktime(&tm);
+#else
+  std::time_t end = m_utcTimestamps ? timegm(&tm) : std::mktime(&tm);
+#endif
+  m_nextRotationTime = std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::system_clock::from_time_t(end) - now);
 }
 
-void Logger::error(const char *format, ...)
+std::string Logger::nextArchivePath()
 {
-  if (!m_initialized || LogLevel::ERR > m_currentLevel)
+  if (m_archiveNaming == ArchiveNaming::BACKUP)
   {
-    return;
+    return m_logFilePath + ".bak";
   }
 
-  char buffer[m_bufferSize];
-  va_list args;
-  va_start(args, format);
-  vsnprintf(buffer, m_bufferSize, format, args);
-  va_end(args);
+  if (m_archiveNaming == ArchiveNaming::NUMBERED)
+  {
+    return m_logFilePath + "." + std::to_string(m_nextArchiveNumber++);
+  }
+
+  std::string stamp = m_periodStamp;
+  if (m_rotationInterval == RotationInterval::NONE)
+  {
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm tm = calendarTime(now, m_utcTimestamps);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y%m%d-%H%M%S", &tm);
+    stamp = buffer;
+  }
 
-  log(LogLevel::ERR, "%s", buffer);
+  std::string path = m_logFilePath + "." + stamp;
+  if (m_lastArchiveStamp == stamp)
+  {
+    path += "." + std::to_string(++m_archiveStampCount);
+  }
+  else
+  {
+    m_lastArchiveStamp = stamp;
+    m_archiveStampCount = 0;
+  }
+  return path;
 }
 
-void Logger::warning(const char *format, ...)
+// Finishes or undoes compressions cut short by a crash. compressArchive() removes the
+// claimed original before moving its output into place, so an output with its original
+// still claimed is partial and deleted, and the original gets its name back to be
+// compressed again; an output without one only lacks the final rename. Runs once at
+// init, before loadArchives() and the compression threads.
+void Logger::recoverArchives()
 {
-  if (!m_initialized || LogLevel::WARNING > m_currentLevel)
+  std::filesystem::path logPath(m_logFilePath);
+  std::filesystem::path dir = logPath.parent_path().empty() ? "." : logPath.parent_path();
+  std::string prefix = logPath.filename().string() + ".";
+  const std::string claimed = ".compressing";
+  const std::string partial = ".tmp";
+
+  std::vector<std::string> claimedFiles;
+  std::vector<std::string> outputs;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
   {
-    return;
+    std::string name = entry.path().filename().string();
+    if (name.compare(0, prefix.size(), prefix) != 0 || !entry.is_regular_file(ec))
+      continue;
+    if (name.ends_with(claimed))
+      claimedFiles.push_back(entry.path().string());
+    else if (name.ends_with(partial))
+      outputs.push_back(entry.path().string());
   }
 
-  char buffer[m_bufferSize];
-  va_list args;
-  va_start(args, format);
-  vsnprintf(buffer, m_bufferSize, format, args);
-  va_end(args);
+  for (const auto &output : outputs)
+  {
+    std::string target = output.substr(0, output.size() - partial.size());
+    std::string archivePath = target;
+    for (const char *extension : {".gz", ".zst"})
+    {
+      if (archivePath.ends_with(extension))
+        archivePath.resize(archivePath.size() - std::strlen(extension));
+    }
+
+    if (std::filesystem::exists(archivePath + claimed, ec))
+      std::filesystem::remove(output, ec);
+    else
+      std::filesystem::rename(output, target, ec);
+  }
 
-  log(LogLevel::WARNING, "%s", buffer);
+  for (const auto &path : claimedFiles)
+  {
+    // A file with the archive's name can only be a newer BACKUP, which supersedes this one
+    std::string archivePath = path.substr(0, path.size() - claimed.size());
+    if (!std::filesystem::exists(archivePath, ec))
+    {
+      std::filesystem::rename(path, archivePath, ec);
+      if (!ec)
+      {
+        if (m_compression != Compression::NONE)
+          m_compressionQueue.push_back(archivePath);
+        continue;
+      }
+    }
+    std::filesystem::remove(path, ec);
+  }
 }
 
-void Logger::info(const char *format, ...)
+// Picks up archives from earlier runs, in rotation order. Like recoverArchives() it lists the
+// directory once at init; after that the archive list is only kept in memory.
+void Logger::loadArchives()
 {
-  if (!m_initialized || LogLevel::INFO > m_currentLevel)
+  std::filesystem::path logPath(m_logFilePath);
+  std::filesystem::path dir = logPath.parent_path().empty() ? "." : logPath.parent_path();
+  std::string prefix = logPath.filename().string() + ".";
+
+  struct Found
   {
-    return;
-  }
+    uint64_t number;      // NUMBERED sequence, or the same-second counter
+    std::string stamp;    // TIMESTAMPED only
+    ArchiveFile file;
+  };
+  std::vector<Found> found;
 
-  char buffer[m_bufferSize];
-  va_list args;
-  va_start(args, format);
-  vsnprintf(buffer, m_bufferSize, format, args);
-  va_end(args);
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+  {
+    std::string name = entry.path().filename().string();
+    if (name.compare(0, prefix.size(), prefix) != 0 || !entry.is_regular_file(ec))
+      continue;
 
-  log(LogLevel::INFO, "%s", buffer);
-}
+    // Compressed archives keep their place in the order
+    std::string suffix = name.substr(prefix.size());
+    for (const char *extension : {".gz", ".zst"})
+    {
+      size_t length = std::strlen(extension);
+      if (suffix.size() > length && suffix.compare(suffix.size() - length, length, extension) == 0)
+        suffix.resize(suffix.size() - length);
+    }
 
-void Logger::debug(const char *format, ...)
-{
-  if (!m_initialized || LogLevel::DEBUG > m_currentLevel)
+    Found archive{0, "", {entry.path().string(), 0}};
+    auto isDigits = [](const std::string &text)
+    {
+      return !text.empty() && std::all_of(text.begin(), text.end(), [](unsigned char c)
+                                          { return std::isdigit(c) != 0; });
+    };
+
+    if (m_archiveNaming == ArchiveNaming::NUMBERED)
+    {
+      if (!isDigits(suffix))
+        continue;
+      archive.number = std::stoull(suffix);
+    }
+    else
+    {
+      // YYYYMMDD[-HH[MMSS]][.N], depending on what the stamp marks
+      size_t stampLength = m_rotationInterval == RotationInterval::DAILY    ? 8
+                           : m_rotationInterval == RotationInterval::HOURLY ? 11
+                                                                            : 15;
+      std::string stamp = suffix.substr(0, stampLength);
+      std::string counter = suffix.size() > stampLength + 1 ? suffix.substr(stampLength + 1) : "";
+      if (stamp.size() != stampLength || !isDigits(stamp.substr(0, 8)) ||
+          (stampLength > 8 && (stamp[8] != '-' || !isDigits(stamp.substr(9)))) ||
+          (suffix.size() > stampLength && (suffix[stampLength] != '.' || !isDigits(counter))))
+        continue;
+      archive.stamp = stamp;
+      archive.number = counter.empty() ? 0 : std::stoull(counter);
+    }
+
+    archive.file.size = entry.file_size(ec);
+    found.push_back(std::move(archive));
+  }
+
+  std::sort(found.begin(), found.end(), [](const Found &a, const Found &b)
+            { return a.stamp != b.stamp ? a.stamp < b.stamp : a.number < b.number; });
+
+  for (auto &archive : found)
   {
-    return;
+    m_archiveBytes += archive.file.size;
+    m_archives.push_back(std::move(archive.file));
   }
 
-  char buffer[m_bufferSize];
-  va_list args;
-  va_start(args, format);
-  vsnprintf(buffer, m_bufferSize, format, args);
-  va_end(args);
+  if (!found.empty())
+  {
+    m_nextArchiveNumber = found.back().number + 1;
+    m_lastArchiveStamp = found.back().stamp;
+    m_archiveStampCount = static_cast<unsigned>(found.back().number);
+  }
 
-  log(LogLevel::DEBUG, "%s", buffer);
+  enforceRetention();
 }
 
-void Logger::log(LogLevel level, const char *format, ...)
+void Logger::startCompression(unsigned threads)
 {
-  if (!m_initialized || level > m_currentLevel)
+  m_stopCompression = false;
+  for (unsigned i = 0; i < std::max(threads, 1u); i++)
   {
-    return;
+    m_compressionThreads.emplace_back(&Logger::compressionLoop, this);
   }
+}
 
-  std::ostringstream logStream;
-  char buffer[m_bufferSize];
-  char timestampBuffer[TIME_STAMP_BUFFER];
-
-  getTimestamp(timestampBuffer, sizeof(timestampBuffer));
+void Logger::stopCompression()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_compressionMutex);
+    m_stopCompression = true;
+  }
+  m_compressionCv.notify_all();
 
-  va_list args;
-  va_start(args, format);
-  vsnprintf(buffer, m_bufferSize, format, args);
-  va_end(args);
+  for (auto &thread : m_compressionThreads)
+  {
+    thread.join();
+  }
+  m_compressionThreads.clear();
+}
 
-  lockMutex();
+void Logger::compressionLoop()
+{
+#ifdef __linux__
+  // Linux applies nice values per thread, so this leaves the logging threads alone
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
 
-  logStream << "[" << timestampBuffer << "] [" << logLevelToString(level) << "] " << buffer << "\n";
-  std::string logEntry = logStream.str();
+  std::unique_lock<std::mutex> lock(m_compressionMutex);
+  while (true)
+  {
+    m_compressionCv.wait(lock, [this]
+                         { return m_stopCompression || !m_compressionQueue.empty(); });
+    if (m_stopCompression)
+      break; // Archives still queued stay uncompressed
+
+    std::string path = std::move(m_compressionQueue.front());
+    m_compressionQueue.pop_front();
+    lock.unlock();
+    compressArchive(path);
+    lock.lock();
+  }
+}
 
-  if (m_consoleOutput)
+void Logger::compressArchive(const std::string &path)
+{
+  // Claim the file first: with BACKUP naming the next rotation reuses its name
+  std::string source = path + ".compressing";
+  std::error_code ec;
+  std::filesystem::rename(path, source, ec);
+  if (ec)
   {
-    std::cout << logEntry;
+    return; // Already pruned by retention or replaced by a newer backup
   }
 
-  if (!openLogFile())
+  std::string target = path + (m_compression == Compression::ZSTD ? ".zst" : ".gz");
+  std::string temporary = target + ".tmp";
+  bool compressed = false;
+#ifdef LOGGER_HAVE_ZSTD
+  if (m_compression == Compression::ZSTD)
+    compressed = zstdFile(source, temporary);
+#endif
+#ifdef LOGGER_HAVE_ZLIB
+  if (m_compression == Compression::GZIP)
+    compressed = gzipFile(source, temporary);
+#endif
+
+  if (!compressed)
   {
-    unlockMutex();
+    std::cerr << "Failed to compress log file: " << path << "\n";
+    std::filesystem::remove(temporary, ec);
+    if (!std::filesystem::exists(path))
+      std::filesystem::rename(source, path, ec);
+    else
+      std::filesystem::remove(source, ec);
     return;
   }
 
-  checkRotation(logEntry.size());
+  // Removing the original first marks the output complete for recoverArchives()
+  std::filesystem::remove(source, ec);
+  std::filesystem::rename(temporary, target, ec);
+  if (ec)
+  {
+    std::cerr << "Failed to rename compressed log file: " << ec.message() << "\n";
+    return; // Renamed at the next init
+  }
 
-  m_messageBuffer.push_back(std::move(logEntry));
-  m_currentFileSize += logEntry.size();
+  uint64_t size = std::filesystem::file_size(target, ec);
 
-  auto now = std::chrono::steady_clock::now();
-  auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastFlushTime).count();
+  if (m_archiveNaming == ArchiveNaming::BACKUP)
+  {
+    return;
+  }
 
-  if (m_messageBuffer.size() >= LOG_BUFFER_CAPACITY || elapsedMs >= FLUSH_INTERVAL_MS)
+  std::lock_guard<std::mutex> lock(m_archiveMutex);
+  auto archive = std::find_if(m_archives.rbegin(), m_archives.rend(), [&path](const ArchiveFile &file)
+                              { return file.path == path; });
+  if (archive == m_archives.rend())
   {
-    flushBuffer();
+    // Retention dropped it while it was being compressed
+    std::filesystem::remove(target, ec);
+    return;
   }
 
-  unlockMutex();
+  m_archiveBytes = m_archiveBytes - archive->size + size;
+  archive->path = target;
+  archive->size = size;
 }
 
-void Logger::lockMutex()
+// Called with m_archiveMutex held (or before any other thread runs)
+void Logger::enforceRetention()
 {
-  static_cast<std::mutex *>(&m_logMutex)->lock();
-}
+  while (!m_archives.empty() &&
+         ((m_maxArchiveFiles > 0 && m_archives.size() > m_maxArchiveFiles) ||
+          (m_maxArchiveBytes > 0 && m_archiveBytes > m_maxArchiveBytes)))
+  {
+    std::error_code ec;
+    std::filesystem::remove(m_archives.front().path, ec);
+    // Gone already when a compression thread has it claimed; it drops the archive itself
+    if (ec && ec != std::errc::no_such_file_or_directory)
+    {
+      std::cerr << "Failed to remove archived log file: " << ec.message() << "\n";
+    }
 
-void Logger::unlockMutex()
-{
-  static_cast<std::mutex *>(&m_logMutex)->unlock();
+    m_archiveBytes -= m_archives.front().size;
+    m_archives.pop_front();
+  }
 }
 
-bool Logger::validateLogPath(const std::string &path)
+// Switches to the file the maintenance thread pre-opened and leaves renaming, closing and
+// preparing the following one to it; see rollBackRotation() for when renaming fails.
+// Windows can't rename open files, so it rotates inline.
+void Logger::checkRotation(size_t messageSize, std::chrono::steady_clock::time_point now)
 {
-  if (path.find("..") != std::string::npos)
-    return false; // Potential directory traversal
+  bool periodEnded = now >= m_nextRotationTime;
+  if (!periodEnded && m_currentFileSize + messageSize <= m_maxFileSize)
+  {
+    return;
+  }
 
-  return true;
-}
+  flushBuffer();
 
-bool Logger::openLogFile()
-{
-  std::filesystem::path logPath(m_logFilePath);
-  std::filesystem::path logDir = logPath.parent_path();
+  // Named after the period the file covers, so this comes before moving to the next one
+  std::string archivePath = nextArchivePath();
+  if (periodEnded)
+    schedulePeriodRotation();
 
-  try
+#ifndef _WIN32
   {
-    if (std::filesystem::exists(logDir) && !std::filesystem::is_directory(logDir))
+    std::unique_lock<std::mutex> lock(m_maintenanceMutex);
+    // Only waits when rotations come faster than the maintenance thread can prepare files
+    m_maintenanceDoneCv.wait(lock, [this]
+                             { return m_nextSink || m_nextSinkFailed || m_rotationRolledBack; });
+    if (m_rotationRolledBack)
     {
-      std::cerr << "Log path is not a directory: '" << logDir << "'\n";
-      return false;
+      // The previous switch failed after all; try again after another maxFileSize bytes
+      lock.unlock();
+      rollBackRotation();
+      return;
     }
 
-    if (m_logFile.is_open())
+    if (m_nextSink)
     {
-      return true;
+      m_retiredSink = std::move(m_sink);
+      m_retiredArchivePath = std::move(archivePath);
+      m_sink = std::move(m_nextSink);
+      m_rotationPending = true;
+      m_currentFileSize = m_sink->size();
+      // The maintenance thread syncs the old file before closing it
+      m_unsyncedBytes = 0;
+      m_lastSyncTime = now;
+      m_maintenanceCv.notify_one();
+      return;
     }
 
-    m_logFile.open(m_logFilePath, std::ios_base::app | std::ios_base::out);
-
-    if (!m_logFile.is_open())
-    {
-      m_logFile.open(m_logFilePath, std::ios_base::out);
-      if (!m_logFile.is_open())
-        return false;
-    }
+    // Preparing failed: rotate inline and let the maintenance thread try again
+    m_nextSinkFailed = false;
+    m_maintenanceCv.notify_one();
+  }
+#endif
 
-    m_logFile.seekp(0, std::ios_base::end);
-    m_currentFileSize = static_cast<size_t>(m_logFile.tellp());
+  if (m_durability != DurabilityMode::NONE)
+    syncLogFile(true);
+  closeLogFile();
+  if (rotateLogFile(archivePath))
+    addArchive(archivePath);
+  // The directory may have been removed since init
+  if (createLogDirectory(m_logFilePath))
+    openLogFile();
 
-    return true;
-  }
-  catch (const std::filesystem::filesystem_error& e)
-  {
-    std::cerr << "Filesystem error: " << e.what() << "\n";
-    return false;
-  }
+  m_currentFileSize = 0;
 }
 
-void Logger::closeLogFile()
+void Logger::startMaintenance()
 {
-  if (m_logFile.is_open())
-    m_logFile.close();
+  m_stopMaintenance = false;
+  m_maintenanceThread = std::thread(&Logger::maintenanceLoop, this);
 }
 
-void Logger::flushBuffer()
+void Logger::stopMaintenance()
 {
-  for (const auto &message : m_messageBuffer)
   {
-    m_logFile << message;
+    std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+    m_stopMaintenance = true;
   }
+  m_maintenanceCv.notify_one();
 
-  m_logFile.flush();
-  m_messageBuffer.clear();
-}
+  if (m_maintenanceThread.joinable())
+    m_maintenanceThread.join();
 
-void Logger::flush()
-{
-  lockMutex();
-  flushBuffer();
-  unlockMutex();
+  // Nothing was written to a next file that was never switched to
+  if (m_nextSink)
+  {
+    bool empty = m_nextSink->size() == 0;
+    m_nextSink->close();
+    m_nextSink.reset();
+    if (empty)
+    {
+      std::error_code ec;
+      std::filesystem::remove(m_logFilePath + LOG_NEXT_FILE_SUFFIX, ec);
+    }
+  }
 }
 
-bool Logger::createLogDirectory(const std::string &filePath)
+void Logger::maintenanceLoop()
 {
-  std::filesystem::path path(filePath);
-  std::filesystem::path dir = path.parent_path();
+  std::string nextPath = m_logFilePath + LOG_NEXT_FILE_SUFFIX;
+  std::unique_lock<std::mutex> lock(m_maintenanceMutex);
 
-  if (dir.empty())
+  while (true)
   {
-    return true;
-  }
+    if (m_retiredSink)
+    {
+      // The logger already writes to the next file; give it the log file's name
+      std::unique_ptr<LogSink> retired = std::move(m_retiredSink);
+      std::string archivePath = std::move(m_retiredArchivePath);
+      lock.unlock();
+
+      // Renaming leaves both open files alone
+      bool renamed = rotateLogFile(archivePath);
+      if (renamed)
+      {
+        std::error_code ec;
+        std::filesystem::rename(nextPath, m_logFilePath, ec);
+        if (ec)
+        {
+          std::cerr << "Failed to rename next log file: " << ec.message() << "\n";
+          std::filesystem::rename(archivePath, m_logFilePath, ec);
+          renamed = false;
+        }
+      }
+
+      if (renamed)
+      {
+        // Off the logging path, unlike a sync before the switch would be
+        if (m_durability != DurabilityMode::NONE)
+        {
+          retired->sync();
+          retired->waitForWrites();
+        }
+        retired->close();
+        retired.reset();
+        addArchive(archivePath);
+      }
+
+      lock.lock();
+      if (!renamed)
+      {
+        // Still open: the logger switches back to it on its next write
+        m_restoredSink = std::move(retired);
+        m_rotationRolledBack.store(true, std::memory_order_release);
+      }
+      m_rotationPending = false;
+      m_maintenanceDoneCv.notify_all();
+      continue;
+    }
 
-  try
-  {
-    if (!std::filesystem::exists(dir))
+    // After a failed rotation the next file is the current one until the logger switches back
+    if (!m_nextSink && !m_nextSinkFailed && !m_stopMaintenance && !m_rotationRolledBack)
     {
-      return std::filesystem::create_directories(dir);
+      lock.unlock();
+
+      // A next file left by a crash is appended to rather than lost
+      std::unique_ptr<LogSink> sink = createSink();
+      bool opened = createLogDirectory(m_logFilePath) && sink->open(nextPath);
+
+      lock.lock();
+      if (opened)
+        m_nextSink = std::move(sink);
+      else
+        m_nextSinkFailed = true;
+      m_maintenanceDoneCv.notify_all();
+      continue;
     }
-    return true;
-  }
-  catch (const std::filesystem::filesystem_error &e)
-  {
-    std::cerr << "Error creating directory: " << e.what() << std::endl;
-    return false;
+
+    if (m_stopMaintenance)
+      break;
+
+    m_maintenanceCv.wait(lock);
   }
 }
 
-void Logger::rotateLogFile()
+std::chrono::system_clock::time_point Logger::currentTime() const
 {
-  std::string backupFileName = std::string(m_logFilePath) + ".bak";
-  if (std::filesystem::exists(backupFileName))
+#ifdef CLOCK_REALTIME_COARSE
+  if (m_clockSource == ClockSource::REALTIME_COARSE)
   {
-    std::error_code ec;
-    std::filesystem::remove(backupFileName, ec);
-    if (ec)
-    {
-      std::cerr << "Failed to remove backup file: " << ec.message() << "\n";
-    }
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    auto sinceEpoch = std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(sinceEpoch));
   }
+#endif
 
-  std::error_code ec;
-  std::filesystem::rename(m_logFilePath, backupFileName, ec);
-  if (ec)
-  {
-    std::cerr << "Failed to rename log file: " << ec.message() << "\n";
-  }
+  return std::chrono::system_clock::now();
+}
+
+void Logger::getTimestamp(char *buffer, size_t bufferSize)
+{
+  getTimestamp(currentTime(), buffer, bufferSize);
 }
 
-void Logger::checkRotation(size_t messageSize)
+void Logger::getTimestamp(std::chrono::system_clock::time_point now, char *buffer, size_t bufferSize)
 {
-  if (m_currentFileSize + messageSize > m_maxFileSize)
+  // The date and time of day only change once per second, so each thread keeps
+  // its last formatted prefix and only the sub-second digits are written per call
+  thread_local std::chrono::sys_seconds cachedSecond;
+  thread_local bool cachedUtc = false;
+  thread_local char cachedPrefix[TIME_STAMP_BUFFER] = {};
+  thread_local size_t cachedPrefixLength = 0;
+
+  auto second = std::chrono::floor<std::chrono::seconds>(now);
+  auto subsecondNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - second).count();
+
+  if (cachedPrefixLength == 0 || second != cachedSecond || cachedUtc != m_utcTimestamps)
   {
-    for (const auto &message : m_messageBuffer)
+    int year, month, day, hour, minute, sec;
+
+    if (m_utcTimestamps)
     {
-      m_logFile << message;
+      // Plain calendar arithmetic, no time zone lookup
+      auto days = std::chrono::floor<std::chrono::days>(second);
+      std::chrono::year_month_day date(days);
+      std::chrono::hh_mm_ss<std::chrono::seconds> time(second - days);
+      year = static_cast<int>(date.year());
+      month = static_cast<int>(static_cast<unsigned>(date.month()));
+      day = static_cast<int>(static_cast<unsigned>(date.day()));
+      hour = static_cast<int>(time.hours().count());
+      minute = static_cast<int>(time.minutes().count());
+      sec = static_cast<int>(time.seconds().count());
     }
-    m_messageBuffer.clear();
+    else
+    {
+      std::time_t now_time_t = std::chrono::system_clock::to_time_t(second);
+      std::tm now_tm;
 
-    closeLogFile();
-    rotateLogFile();
-    openLogFile();
+#ifdef _WIN32
+      localtime_s(&now_tm, &now_time_t);
+#else
+      localtime_r(&now_time_t, &now_tm);
+#endif
+      year = now_tm.tm_year + 1900;
+      month = now_tm.tm_mon + 1;
+      day = now_tm.tm_mday;
+      hour = now_tm.tm_hour;
+      minute = now_tm.tm_min;
+      sec = now_tm.tm_sec;
+    }
 
-    m_currentFileSize = 0;
+    int written = snprintf(cachedPrefix, sizeof(cachedPrefix), "%04d-%02d-%02d %02d:%02d:%02d.",
+                           year, month, day, hour, minute, sec);
+    cachedPrefixLength = std::min(static_cast<size_t>(std::max(written, 0)), sizeof(cachedPrefix) - 1);
+    cachedSecond = second;
+    cachedUtc = m_utcTimestamps;
   }
-}
 
-void Logger::getTimestamp(char *buffer, size_t bufferSize)
-{
-  auto now = std::chrono::system_clock::now();
-  auto now_time_t = std::chrono::system_clock::to_time_t(now);
-  auto now_ms = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()) % 1000;
-  std::tm now_tm;
+  int digits = static_cast<int>(m_timestampPrecision);
+  unsigned subsecond = static_cast<unsigned>(subsecondNs);
+  for (int i = digits; i < 9; i++)
+  {
+    subsecond /= 10;
+  }
 
-#ifdef _WIN32
-  localtime_s(&now_tm, &now_time_t);
-#else
-  localtime_r(&now_time_t, &now_tm);
-#endif
-  snprintf(buffer, bufferSize, "%04d-%02d-%02d %02d:%02d:%02d.%03ld",
-           now_tm.tm_year + 1900,
-           now_tm.tm_mon + 1,
-           now_tm.tm_mday,
-           now_tm.tm_hour,
-           now_tm.tm_min,
-           now_tm.tm_sec,
-           (long)now_ms.count());
+  char timestamp[TIME_STAMP_BUFFER + 9];
+  std::memcpy(timestamp, cachedPrefix, cachedPrefixLength);
+  writeDigits(timestamp + cachedPrefixLength, subsecond, digits);
+
+  size_t length = std::min(cachedPrefixLength + digits, bufferSize - 1);
+  std::memcpy(buffer, timestamp, length);
+  buffer[length] = '\0';
 }
 
 const char *Logger::logLevelToString(LogLevel level)
@@ -372,10 +3094,10 @@ const char *Logger::logLevelToString(LogLevel level)
 
 void Logger::setLevel(LogLevel level)
 {
-  m_currentLevel = level;
+  m_currentLevel.store(level, std::memory_order_relaxed);
 }
 
 void Logger::setConsoleOutput(bool enable)
 {
-  m_consoleOutput = enable;
+  m_consoleOutput.store(enable, std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+
+// Compile this file as if the build had been configured with -DLOGGER_ACTIVE_LEVEL=WARNING
+#undef LOGGER_ACTIVE_LEVEL
+#define LOGGER_ACTIVE_LEVEL 1
+#include "logger.hpp"
+
+static int g_evaluations = 0;
+
+static int countEvaluation()
+{
+  return ++g_evaluations;
+}
+
+// Test that macros below the compile-time level don't evaluate their arguments
+TEST(LoggerActiveLevelTest, MacrosBelowActiveLevelCompileOut)
+{
+  g_evaluations = 0;
+
+  LOG_DEBUG("Debug %d", countEvaluation());
+  LOG_INFO("Info %d", countEvaluation());
+  EXPECT_EQ(g_evaluations, 0);
+
+  LOG_WARNING("Warning %d", countEvaluation());
+  LOG_ERROR("Error %d", countEvaluation());
+  EXPECT_EQ(g_evaluations, 2);
+}
@@ -4,8 +4,45 @@
 #include <string>
 #include <thread>
 #include <regex>
+#include <new>
+#include <cstdlib>
 #include "logger.hpp"
 
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+// Counts heap allocations made by the current thread while enabled
+static thread_local bool g_countAllocations = false;
+static thread_local size_t g_allocationCount = 0;
+
+void *operator new(std::size_t size)
+{
+  if (g_countAllocations)
+    g_allocationCount++;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+// GCC flags free() on memory from the replaced operator new as mismatched once inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 class LoggerTest : public ::testing::Test
 {
 protected:
@@ -352,4 +389,987 @@ TEST_F(LoggerTest, ThreadSafety)
   // Total message count should be close to NUM_THREADS * MSGS_PER_THREAD
   // We use a tolerance to account for possible race conditions
   EXPECT_GE(totalMsgCount, NUM_THREADS * MSGS_PER_THREAD - NUM_THREADS);
-}
\ No newline at end of file
+}
+// Test asynchronous mode where a backend thread owns the log file
+TEST_F(LoggerTest, AsyncMode)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.level = LogLevel::DEBUG;
+  config.consoleOutput = false;
+  config.asyncMode = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  constexpr int NUM_THREADS = 4;
+  constexpr int MSGS_PER_THREAD = 50;
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < NUM_THREADS; t++)
+  {
+    threads.emplace_back([t]()
+                         {
+      for (int i = 0; i < MSGS_PER_THREAD; i++)
+      {
+        LOG_INFO("Async thread %d message %d", t, i);
+      } });
+  }
+
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+
+  // flush() must wait for the backend to drain everything enqueued so far
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+
+  for (int t = 0; t < NUM_THREADS; t++)
+  {
+    for (int i = 0; i < MSGS_PER_THREAD; i++)
+    {
+      std::string messageToFind = "Async thread " + std::to_string(t) + " message " + std::to_string(i) + "\n";
+      EXPECT_TRUE(logContent.find(messageToFind) != std::string::npos)
+          << "Should find message " << i << " from thread " << t;
+    }
+  }
+}
+
+// Test that a single producer outrunning its queue loses nothing
+TEST_F(LoggerTest, AsyncQueueWraparound)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 16 * 1024 * 1024;
+  config.asyncMode = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  constexpr int NUM_LOGS = LOG_QUEUE_CAPACITY * 4;
+  for (int i = 0; i < NUM_LOGS; i++)
+  {
+    LOG_INFO("Wraparound message %d", i);
+  }
+
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  size_t count = 0;
+  for (size_t pos = logContent.find("Wraparound message"); pos != std::string::npos;
+       pos = logContent.find("Wraparound message", pos + 1))
+  {
+    count++;
+  }
+
+  EXPECT_EQ(count, static_cast<size_t>(NUM_LOGS));
+  EXPECT_TRUE(logContent.find("Wraparound message " + std::to_string(NUM_LOGS - 1) + "\n") != std::string::npos);
+}
+
+// Test that every record is either written or counted as dropped under each overflow policy
+static void runOverflowPolicyTest(const std::string &logPath, OverflowPolicy policy)
+{
+  LoggerConfig config;
+  config.logFilePath = logPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 16 * 1024 * 1024;
+  config.asyncMode = true;
+  config.queueCapacity = 4;
+  config.overflowPolicy = policy;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  constexpr int NUM_LOGS = 2000;
+  for (int i = 0; i < NUM_LOGS; i++)
+  {
+    LOG_INFO("Overflow message %d", i);
+  }
+
+  Logger::getInstance().flush();
+
+  std::ifstream file(logPath);
+  std::string line;
+  uint64_t written = 0;
+  bool lastFound = false;
+  while (std::getline(file, line))
+  {
+    if (line.find("Overflow message") != std::string::npos)
+      written++;
+    if (line.ends_with("Overflow message " + std::to_string(NUM_LOGS - 1)))
+      lastFound = true;
+  }
+
+  EXPECT_EQ(written + Logger::getInstance().droppedCount(), static_cast<uint64_t>(NUM_LOGS));
+  if (policy != OverflowPolicy::DROP_NEWEST)
+  {
+    EXPECT_TRUE(lastFound);
+  }
+  if (policy == OverflowPolicy::BLOCK)
+  {
+    EXPECT_EQ(Logger::getInstance().droppedCount(), 0u);
+  }
+}
+
+TEST_F(LoggerTest, OverflowPolicyBlock)
+{
+  runOverflowPolicyTest(m_testLogPath, OverflowPolicy::BLOCK);
+}
+
+TEST_F(LoggerTest, OverflowPolicyDropNewest)
+{
+  runOverflowPolicyTest(m_testLogPath, OverflowPolicy::DROP_NEWEST);
+}
+
+TEST_F(LoggerTest, OverflowPolicyOverwriteOldest)
+{
+  runOverflowPolicyTest(m_testLogPath, OverflowPolicy::OVERWRITE_OLDEST);
+}
+
+// Test that deferred formatting on the backend matches formatting on the caller
+TEST_F(LoggerTest, DeferredFormatting)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.asyncMode = true;
+  config.deferredFormatting = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::string transient = "transient string";
+  int value = -42;
+  LOG_INFO("Deferred: %d|%5u|%-4x|%lld|%zu|%c|%.3f|%8.2e|%*d|%.*s|%s|%%|%p",
+           value, 7u, 0xabu, -1234567890123LL, static_cast<size_t>(99), 'Z', 3.14159, 12345.678,
+           6, 17, 4, "truncated", transient.c_str(), static_cast<void *>(&value));
+  transient.assign("overwritten before the backend runs");
+
+  // Wide strings are not captured, so this one falls back to caller-side formatting
+  LOG_INFO("Fallback: %ls", L"wide");
+
+  Logger::getInstance().flush();
+
+  char expected[BUFFER_SIZE];
+  snprintf(expected, sizeof(expected), "Deferred: %d|%5u|%-4x|%lld|%zu|%c|%.3f|%8.2e|%*d|%.*s|%s|%%|%p",
+           value, 7u, 0xabu, -1234567890123LL, static_cast<size_t>(99), 'Z', 3.14159, 12345.678,
+           6, 17, 4, "truncated", "transient string", static_cast<void *>(&value));
+
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_TRUE(logContent.find(std::string(expected) + "\n") != std::string::npos)
+      << "Expected: " << expected << "\nLog:\n" << logContent;
+  EXPECT_TRUE(logContent.find("Fallback: wide\n") != std::string::npos);
+}
+
+// Test that deferred %s captures read no further than the precision allows
+TEST_F(LoggerTest, DeferredStringPrecision)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.asyncMode = true;
+  config.deferredFormatting = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  // Neither array is NUL terminated; a sanitizer build catches reads past them
+  std::unique_ptr<char[]> tag(new char[4]{'A', 'B', 'C', 'D'});
+  std::unique_ptr<char[]> code(new char[3]{'x', 'y', 'z'});
+  LOG_INFO("Tags: %.4s|%.*s|%.2s", tag.get(), 3, code.get(), tag.get());
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_NE(logContent.find("Tags: ABCD|xyz|AB\n"), std::string::npos) << logContent;
+}
+
+// Test that the level wrappers and log() format alike, leaving '%' in arguments alone
+TEST_F(LoggerTest, WrappersMatchLog)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::DEBUG, false));
+
+  LOG_INFO("Wrapper %s %d", "100%d", 5);
+  Logger::getInstance().log(LogLevel::INFO, "Direct %s %d", "100%d", 5);
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_TRUE(logContent.find("[INFO ] Wrapper 100%d 5\n") != std::string::npos);
+  EXPECT_TRUE(logContent.find("[INFO ] Direct 100%d 5\n") != std::string::npos);
+}
+
+// Test that steady-state logging makes no heap allocations on the calling thread
+static size_t countLoggingAllocations(int numLogs)
+{
+  g_allocationCount = 0;
+  g_countAllocations = true;
+  for (int i = 0; i < numLogs; i++)
+  {
+    LOG_INFO("Allocation test message %d with value %.2f", i, i * 0.5);
+  }
+  g_countAllocations = false;
+  return g_allocationCount;
+}
+
+TEST_F(LoggerTest, NoAllocationsPerLogCall)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::INFO, false, 16 * 1024 * 1024));
+
+  // Warm up: grows the message buffer and lets the C library set up its locale and time zone state
+  countLoggingAllocations(LOG_BUFFER_CAPACITY * 2);
+
+  EXPECT_EQ(countLoggingAllocations(1000), 0u);
+}
+
+TEST_F(LoggerTest, NoAllocationsPerAsyncLogCall)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 16 * 1024 * 1024;
+  config.asyncMode = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  // Warm up: registers this thread's queue
+  countLoggingAllocations(10);
+  Logger::getInstance().flush();
+
+  EXPECT_EQ(countLoggingAllocations(1000), 0u);
+}
+
+#ifdef LOGGER_HAS_STD_FORMAT
+// Test the compile-time checked std::format API
+TEST_F(LoggerTest, FormatApi)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::DEBUG, false));
+
+  LOG_INFO_FMT("Format {} {:.2f} {} {:>4}", 42, 3.14159, std::string("text"), 'x');
+  LOG_DEBUG_FMT("Literal braces {{}} and {}", -7);
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_TRUE(logContent.find("[INFO ] Format 42 3.14 text    x\n") != std::string::npos);
+  EXPECT_TRUE(logContent.find("[DEBUG] Literal braces {} and -7\n") != std::string::npos);
+}
+#endif
+
+// Test that the macros leave names in the caller's scope alone
+TEST_F(LoggerTest, MacroArgumentNames)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::INFO, false));
+
+  int logger_ = 7;
+  LOG_INFO("Caller variable %d", logger_);
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_NE(logContent.find("Caller variable 7\n"), std::string::npos);
+}
+
+// Test that messages disabled at runtime don't evaluate their arguments
+static int g_argumentEvaluations = 0;
+
+static const char *expensiveArgument()
+{
+  g_argumentEvaluations++;
+  return "expensive";
+}
+
+TEST_F(LoggerTest, DisabledLevelSkipsArgumentEvaluation)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::INFO, false));
+
+  g_argumentEvaluations = 0;
+  LOG_DEBUG("Debug %s", expensiveArgument());
+  EXPECT_EQ(g_argumentEvaluations, 0);
+
+  LOG_INFO("Info %s", expensiveArgument());
+  EXPECT_EQ(g_argumentEvaluations, 1);
+
+  Logger::getInstance().setLevel(LogLevel::ERR);
+  LOG_WARNING("Warning %s", expensiveArgument());
+  EXPECT_EQ(g_argumentEvaluations, 1);
+}
+
+// Test changing the level and console flag while other threads are logging
+TEST_F(LoggerTest, ConcurrentSettingChanges)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::DEBUG, false, 16 * 1024 * 1024));
+
+  constexpr int NUM_THREADS = 4;
+  constexpr int MSGS_PER_THREAD = 500;
+  std::atomic<int> finished(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_THREADS; t++)
+  {
+    threads.emplace_back([t, &finished]()
+                         {
+      for (int i = 0; i < MSGS_PER_THREAD; i++)
+      {
+        LOG_WARNING("Settings thread %d message %d", t, i);
+        LOG_DEBUG("Settings thread %d debug %d", t, i);
+      }
+      finished++; });
+  }
+
+  for (int i = 0; finished.load() < NUM_THREADS; i++)
+  {
+    Logger::getInstance().setLevel(i % 2 ? LogLevel::DEBUG : LogLevel::WARNING);
+    Logger::getInstance().setConsoleOutput(false);
+    std::this_thread::yield();
+  }
+
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+
+  Logger::getInstance().setLevel(LogLevel::WARNING);
+  Logger::getInstance().flush();
+
+  // Warnings pass at either level, so every one of them must be there
+  std::string logContent = readLogFile(m_testLogPath);
+  for (int t = 0; t < NUM_THREADS; t++)
+  {
+    std::string lastMessage = "Settings thread " + std::to_string(t) + " message " + std::to_string(MSGS_PER_THREAD - 1) + "\n";
+    EXPECT_TRUE(logContent.find(lastMessage) != std::string::npos);
+  }
+}
+
+// Test that cached timestamp prefixes still follow the wall clock
+TEST_F(LoggerTest, TimestampFormat)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::INFO, false));
+
+  LOG_INFO("Timestamp first");
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  LOG_INFO("Timestamp second");
+  Logger::getInstance().flush();
+
+  std::ifstream file(m_testLogPath);
+  std::string line;
+  std::regex timestampPattern(R"(^\[(\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2})\.\d{3}\] )");
+  std::vector<std::string> seconds;
+  while (std::getline(file, line))
+  {
+    std::smatch match;
+    ASSERT_TRUE(std::regex_search(line, match, timestampPattern)) << line;
+    if (line.find("Timestamp ") != std::string::npos)
+      seconds.push_back(match[1]);
+  }
+
+  ASSERT_EQ(seconds.size(), 2u);
+  EXPECT_NE(seconds[0], seconds[1]);
+
+  std::time_t now = std::time(nullptr);
+  char today[16];
+  std::strftime(today, sizeof(today), "%Y-%m-%d", std::localtime(&now));
+  EXPECT_EQ(seconds[1].substr(0, 10), today);
+}
+
+// Test that timestamps captured as raw ticks on the caller convert back to wall-clock time
+TEST_F(LoggerTest, AsyncTickTimestamps)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.asyncMode = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+  std::time_t before = std::time(nullptr);
+  LOG_INFO("Tick timestamp");
+  std::time_t after = std::time(nullptr);
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  std::smatch match;
+  std::regex pattern(R"(\[(\d{4})-(\d{2})-(\d{2}) (\d{2}):(\d{2}):(\d{2})\.\d{3}\] \[INFO \] Tick timestamp)");
+  ASSERT_TRUE(std::regex_search(logContent, match, pattern)) << logContent;
+
+  std::tm logged = {};
+  logged.tm_year = std::stoi(match[1]) - 1900;
+  logged.tm_mon = std::stoi(match[2]) - 1;
+  logged.tm_mday = std::stoi(match[3]);
+  logged.tm_hour = std::stoi(match[4]);
+  logged.tm_min = std::stoi(match[5]);
+  logged.tm_sec = std::stoi(match[6]);
+  logged.tm_isdst = -1;
+  std::time_t loggedTime = std::mktime(&logged);
+
+  EXPECT_GE(loggedTime, before - 1);
+  EXPECT_LE(loggedTime, after + 1);
+}
+
+// Test UTC timestamps with nanosecond precision from the coarse clock
+TEST_F(LoggerTest, UtcNanosecondTimestamps)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.clockSource = ClockSource::REALTIME_COARSE;
+  config.timestampPrecision = TimestampPrecision::NANOSECONDS;
+  config.utcTimestamps = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::time_t before = std::time(nullptr);
+  LOG_INFO("UTC timestamp");
+  std::time_t after = std::time(nullptr);
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  std::smatch match;
+  std::regex pattern(R"(\[(\d{4}-\d{2}-\d{2} \d{2}:\d{2}):\d{2}\.\d{9}\] \[INFO \] UTC timestamp)");
+  ASSERT_TRUE(std::regex_search(logContent, match, pattern)) << logContent;
+
+  char expectedBefore[32];
+  char expectedAfter[32];
+  std::strftime(expectedBefore, sizeof(expectedBefore), "%Y-%m-%d %H:%M", std::gmtime(&before));
+  std::strftime(expectedAfter, sizeof(expectedAfter), "%Y-%m-%d %H:%M", std::gmtime(&after));
+  EXPECT_TRUE(match[1] == expectedBefore || match[1] == expectedAfter) << match[1];
+}
+
+// Test that the millisecond field really holds milliseconds
+TEST_F(LoggerTest, MillisecondTimestamps)
+{
+  ASSERT_TRUE(Logger::getInstance().init(m_testLogPath.c_str(), LogLevel::INFO, false));
+
+  auto before = std::chrono::system_clock::now();
+  LOG_INFO("Millisecond timestamp");
+  auto after = std::chrono::system_clock::now();
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  std::smatch match;
+  std::regex pattern(R"(:\d{2}\.(\d{3})\] \[INFO \] Millisecond timestamp)");
+  ASSERT_TRUE(std::regex_search(logContent, match, pattern)) << logContent;
+
+  auto millisecondOf = [](std::chrono::system_clock::time_point time)
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+  };
+  int logged = std::stoi(match[1]);
+  auto first = millisecondOf(before);
+  auto last = millisecondOf(after);
+  if (first <= last)
+  {
+    EXPECT_TRUE(logged >= first && logged <= last) << logged << " not in [" << first << ", " << last << "]";
+  }
+}
+
+// Logs a message far longer than BUFFER_SIZE and checks it arrives whole
+static void runLongMessageTest(const std::string &logPath, bool asyncMode, bool deferredFormatting,
+                               size_t queueCapacity = LoggerConfig().queueCapacity)
+{
+  LoggerConfig config;
+  config.logFilePath = logPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 16 * 1024 * 1024;
+  config.asyncMode = asyncMode;
+  config.deferredFormatting = deferredFormatting;
+  config.queueCapacity = queueCapacity;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::string longText(5000, 'x');
+  for (size_t i = 0; i < longText.size(); i += 100)
+  {
+    longText[i] = static_cast<char>('a' + (i / 100) % 26);
+  }
+
+  LOG_INFO("Short before");
+  LOG_INFO("Long [%s] end", longText.c_str());
+  LOG_INFO("Short after");
+  Logger::getInstance().flush();
+
+  std::ifstream file(logPath);
+  std::string logContent((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  EXPECT_NE(logContent.find("[INFO ] Long [" + longText + "] end\n"), std::string::npos);
+  EXPECT_LT(logContent.find("Short before"), logContent.find("Long ["));
+  EXPECT_LT(logContent.find("Long ["), logContent.find("Short after"));
+}
+
+// Test that messages longer than BUFFER_SIZE are written whole, not truncated
+TEST_F(LoggerTest, LongMessageSync)
+{
+  runLongMessageTest(m_testLogPath, false, false);
+}
+
+TEST_F(LoggerTest, LongMessageAsync)
+{
+  runLongMessageTest(m_testLogPath, true, false);
+}
+
+TEST_F(LoggerTest, LongMessageDeferred)
+{
+  runLongMessageTest(m_testLogPath, true, true);
+}
+
+// Test that a message larger than the whole queue is still written whole, in order
+TEST_F(LoggerTest, LongMessageExceedsQueue)
+{
+  runLongMessageTest(m_testLogPath, true, false, 4);
+}
+
+// Test that the ofstream sink still writes and rotates
+TEST_F(LoggerTest, StreamSink)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 1024;
+  config.sink = SinkType::STREAM;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  for (int i = 0; i < 50; i++)
+  {
+    LOG_INFO("Stream sink message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  EXPECT_TRUE(std::filesystem::exists(m_testLogPath + ".bak"));
+  EXPECT_LE(std::filesystem::file_size(m_testLogPath), 1024u);
+  EXPECT_NE(readLogFile(m_testLogPath).find("Stream sink message 49\n"), std::string::npos);
+}
+
+// Test that a line larger than the whole write buffer goes out after the lines before it
+TEST_F(LoggerTest, LineLargerThanWriteBuffer)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 16 * 1024 * 1024;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::string hugeText(LOG_BUFFER_BYTES * 2, 'h');
+  LOG_INFO("Before huge line");
+  LOG_INFO("%s", hugeText.c_str());
+  LOG_INFO("After huge line");
+  Logger::getInstance().flush();
+
+  std::string logContent = readLogFile(m_testLogPath);
+  size_t huge = logContent.find("] " + hugeText + "\n");
+  ASSERT_NE(huge, std::string::npos);
+  EXPECT_LT(logContent.find("Before huge line\n"), huge);
+  EXPECT_GT(logContent.find("After huge line\n"), huge);
+}
+
+// Test the io_uring sink (or the fd sink it falls back to) across rotation and a long line
+TEST_F(LoggerTest, IoUringSink)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 4 * LOG_URING_BUFFER_SIZE;
+  config.sink = SinkType::IO_URING;
+  config.asyncMode = true;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::string longText(LOG_URING_BUFFER_SIZE, 'u');
+  for (int i = 0; i < 6000; i++)
+  {
+    LOG_INFO("Uring message %d", i);
+  }
+  LOG_INFO("%s", longText.c_str());
+  LOG_INFO("Uring last message");
+  Logger::getInstance().flush();
+
+  EXPECT_TRUE(std::filesystem::exists(m_testLogPath + ".bak"));
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_NE(logContent.find("] " + longText + "\n"), std::string::npos);
+  EXPECT_NE(logContent.find("Uring last message\n"), std::string::npos);
+}
+
+// Test that the mmap sink rotates and trims closed segments to what was written
+TEST_F(LoggerTest, MmapSink)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 4096;
+  config.sink = SinkType::MMAP;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  for (int i = 0; i < 200; i++)
+  {
+    LOG_INFO("Mmap message %d", i);
+  }
+  std::string longText(3 * config.maxFileSize, 'm');
+  LOG_INFO("%s", longText.c_str());
+  LOG_INFO("Mmap last message");
+  Logger::getInstance().flush();
+
+  std::string backupContent = readLogFile(m_testLogPath + ".bak");
+  EXPECT_FALSE(backupContent.empty());
+  EXPECT_EQ(backupContent.find('\0'), std::string::npos);
+  EXPECT_NE(backupContent.find("] " + longText + "\n"), std::string::npos);
+
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_NE(logContent.find("Mmap last message\n"), std::string::npos);
+}
+
+// Logs an ERROR line and checks it reached the file without flush()
+static void runDurabilityTest(const std::string &logPath, SinkType sink, DurabilityMode durability)
+{
+  LoggerConfig config;
+  config.logFilePath = logPath.c_str();
+  config.consoleOutput = false;
+  config.sink = sink;
+  config.durability = durability;
+  config.syncIntervalBytes = 1;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  LOG_INFO("Durability info line");
+  LOG_ERROR("Durability error line");
+
+  std::ifstream file(logPath);
+  std::string logContent((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  EXPECT_NE(logContent.find("Durability info line\n"), std::string::npos);
+  EXPECT_NE(logContent.find("Durability error line\n"), std::string::npos);
+}
+
+TEST_F(LoggerTest, SyncOnError)
+{
+  runDurabilityTest(m_testLogPath, SinkType::FD, DurabilityMode::ON_ERROR);
+}
+
+TEST_F(LoggerTest, SyncOnErrorIoUring)
+{
+  runDurabilityTest(m_testLogPath, SinkType::IO_URING, DurabilityMode::ON_ERROR);
+}
+
+TEST_F(LoggerTest, PeriodicSyncByBytes)
+{
+  runDurabilityTest(m_testLogPath, SinkType::STREAM, DurabilityMode::PERIODIC);
+}
+
+// Test that background rotation loses and reorders nothing across the switch
+TEST_F(LoggerTest, BackgroundRotationKeepsOrder)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 2048;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  constexpr int NUM_LOGS = 500;
+  for (int i = 0; i < NUM_LOGS; i++)
+  {
+    LOG_INFO("Rotation order %d", i);
+  }
+  Logger::getInstance().flush();
+
+  std::regex pattern(R"(Rotation order (\d+)\n)");
+  auto numbersIn = [&pattern](const std::string &content)
+  {
+    std::vector<int> numbers;
+    for (auto it = std::sregex_iterator(content.begin(), content.end(), pattern); it != std::sregex_iterator(); ++it)
+    {
+      numbers.push_back(std::stoi((*it)[1]));
+    }
+    return numbers;
+  };
+
+  std::vector<int> backup = numbersIn(readLogFile(m_testLogPath + ".bak"));
+  std::vector<int> current = numbersIn(readLogFile(m_testLogPath));
+  ASSERT_FALSE(backup.empty());
+  ASSERT_FALSE(current.empty());
+
+  backup.insert(backup.end(), current.begin(), current.end());
+  for (size_t i = 1; i < backup.size(); i++)
+  {
+    EXPECT_EQ(backup[i], backup[i - 1] + 1);
+  }
+  EXPECT_EQ(backup.back(), NUM_LOGS - 1);
+}
+
+// Test that a rotation whose archive can't be created keeps appending to the current file
+TEST_F(LoggerTest, FailedRotationKeepsLog)
+{
+  std::filesystem::create_directories(m_testLogPath + ".bak");
+
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 1024;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  constexpr int NUM_LOGS = 60;
+  for (int i = 0; i < NUM_LOGS; i++)
+  {
+    LOG_INFO("Kept message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  // The rolled-back switches moved their lines back in order, and no next file is left over
+  std::string logContent = readLogFile(m_testLogPath);
+  size_t previous = 0;
+  for (int i = 0; i < NUM_LOGS; i++)
+  {
+    size_t pos = logContent.find("Kept message " + std::to_string(i) + "\n");
+    ASSERT_NE(pos, std::string::npos) << i;
+    EXPECT_GE(pos, previous) << i;
+    previous = pos;
+  }
+  EXPECT_EQ(logContent.find("Kept message 0\n"), logContent.rfind("Kept message 0\n"));
+}
+
+// Test that numbered archives keep the newest generations, including ones from earlier runs
+TEST_F(LoggerTest, NumberedArchiveRetention)
+{
+  // Leftovers of a previous run, to be picked up and pruned oldest first
+  for (int i = 1; i <= 5; i++)
+  {
+    std::ofstream(m_testLogPath + "." + std::to_string(i)) << "old generation " << i << "\n";
+  }
+
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 1024;
+  config.archiveNaming = ArchiveNaming::NUMBERED;
+  config.maxArchiveFiles = 3;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  for (int i = 0; i < 200; i++)
+  {
+    LOG_INFO("Numbered archive message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  std::filesystem::path logPath(m_testLogPath);
+  std::string prefix = logPath.filename().string() + ".";
+  std::vector<int> numbers;
+  for (const auto &entry : std::filesystem::directory_iterator(logPath.parent_path()))
+  {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) == 0 && std::regex_match(name.substr(prefix.size()), std::regex(R"(\d+)")))
+      numbers.push_back(std::stoi(name.substr(prefix.size())));
+  }
+  std::sort(numbers.begin(), numbers.end());
+
+  ASSERT_EQ(numbers.size(), 3u);
+  EXPECT_GT(numbers.front(), 5);
+  EXPECT_EQ(numbers.back() - numbers.front(), 2);
+  EXPECT_FALSE(std::filesystem::exists(m_testLogPath + ".bak"));
+  EXPECT_NE(readLogFile(m_testLogPath + "." + std::to_string(numbers.back())).find("Numbered archive message"),
+            std::string::npos);
+}
+
+// Test that timestamped archives stay within the byte budget
+TEST_F(LoggerTest, TimestampedArchiveByteBudget)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 1024;
+  config.archiveNaming = ArchiveNaming::TIMESTAMPED;
+  config.maxArchiveFiles = 0;
+  config.maxArchiveBytes = 4096;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  for (int i = 0; i < 400; i++)
+  {
+    LOG_INFO("Timestamped archive message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  std::filesystem::path logPath(m_testLogPath);
+  std::string prefix = logPath.filename().string() + ".";
+  std::regex archiveName(R"(\d{8}-\d{6}(\.\d+)?)");
+  uint64_t archiveBytes = 0;
+  size_t archiveCount = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(logPath.parent_path()))
+  {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) == 0 && std::regex_match(name.substr(prefix.size()), archiveName))
+    {
+      archiveBytes += entry.file_size();
+      archiveCount++;
+    }
+  }
+
+  EXPECT_GE(archiveCount, 2u);
+  EXPECT_LE(archiveBytes, 4096u);
+}
+
+#ifdef LOGGER_HAVE_ZLIB
+// Test that archives are replaced by gzip files off the logging threads
+TEST_F(LoggerTest, GzipArchiveCompression)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 4096;
+  config.archiveNaming = ArchiveNaming::NUMBERED;
+  config.maxArchiveFiles = 0;
+  config.compression = Compression::GZIP;
+  config.compressionThreads = 2;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  for (int i = 0; i < 500; i++)
+  {
+    LOG_INFO("Compressed archive message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  // Archive 1 is the first generation; wait for the workers to get through it
+  std::string archive = m_testLogPath + ".1";
+  for (int attempt = 0; attempt < 100 && !std::filesystem::exists(archive + ".gz"); attempt++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  ASSERT_TRUE(std::filesystem::exists(archive + ".gz"));
+  EXPECT_FALSE(std::filesystem::exists(archive));
+  EXPECT_LT(std::filesystem::file_size(archive + ".gz"), 4096u);
+
+  std::string compressed = readLogFile(archive + ".gz");
+  ASSERT_GE(compressed.size(), 2u);
+  EXPECT_EQ(static_cast<unsigned char>(compressed[0]), 0x1f);
+  EXPECT_EQ(static_cast<unsigned char>(compressed[1]), 0x8b);
+}
+#endif
+
+// Test that files left by a compression cut short are recovered at init and then retained as usual
+TEST_F(LoggerTest, InterruptedCompressionRecovered)
+{
+  // Archive 1 was still being compressed, archive 2 only lacked the final rename
+  std::ofstream(m_testLogPath + ".1.compressing") << "claimed archive\n";
+  std::ofstream(m_testLogPath + ".1.gz.tmp") << "partial output";
+  std::ofstream(m_testLogPath + ".2.gz.tmp") << "finished output";
+  // The claimed backup is newer than the compressed one beside it
+  std::ofstream(m_testLogPath + ".bak.compressing") << "newest backup\n";
+  std::ofstream(m_testLogPath + ".bak.gz") << "older backup";
+
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 1024;
+  config.archiveNaming = ArchiveNaming::NUMBERED;
+  config.maxArchiveFiles = 3;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  EXPECT_EQ(readLogFile(m_testLogPath + ".1"), "claimed archive\n");
+  EXPECT_FALSE(std::filesystem::exists(m_testLogPath + ".1.compressing"));
+  EXPECT_FALSE(std::filesystem::exists(m_testLogPath + ".1.gz.tmp"));
+  EXPECT_EQ(readLogFile(m_testLogPath + ".2.gz"), "finished output");
+  EXPECT_FALSE(std::filesystem::exists(m_testLogPath + ".2.gz.tmp"));
+  EXPECT_EQ(readLogFile(m_testLogPath + ".bak"), "newest backup\n");
+  EXPECT_FALSE(std::filesystem::exists(m_testLogPath + ".bak.compressing"));
+
+  // Two more generations push the recovered one out
+  for (int i = 0; i < 60; i++)
+  {
+    LOG_INFO("Recovery message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  EXPECT_TRUE(std::filesystem::exists(m_testLogPath + ".4"));
+  EXPECT_FALSE(std::filesystem::exists(m_testLogPath + ".1"));
+}
+
+// Test that archives of an hourly log carry the hour, with size rotations numbered within it
+TEST_F(LoggerTest, HourlyRotationNames)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 1024;
+  config.rotationInterval = RotationInterval::HOURLY;
+  config.maxArchiveFiles = 0;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  std::time_t before = std::time(nullptr);
+  for (int i = 0; i < 100; i++)
+  {
+    LOG_INFO("Hourly message %d", i);
+  }
+  Logger::getInstance().flush();
+  std::time_t after = std::time(nullptr);
+
+  char firstHour[32];
+  char lastHour[32];
+  std::strftime(firstHour, sizeof(firstHour), "%Y%m%d-%H", std::localtime(&before));
+  std::strftime(lastHour, sizeof(lastHour), "%Y%m%d-%H", std::localtime(&after));
+
+  std::filesystem::path logPath(m_testLogPath);
+  std::string prefix = logPath.filename().string() + ".";
+  std::regex archiveName(R"((\d{8}-\d{2})(\.\d+)?)");
+  size_t archiveCount = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(logPath.parent_path()))
+  {
+    std::string name = entry.path().filename().string();
+    std::smatch match;
+    if (name.rfind(prefix, 0) != 0 || name == prefix + "next")
+      continue;
+
+    std::string suffix = name.substr(prefix.size());
+    ASSERT_TRUE(std::regex_match(suffix, match, archiveName)) << name;
+    EXPECT_TRUE(match[1] == firstHour || match[1] == lastHour) << name;
+    archiveCount++;
+  }
+
+  EXPECT_GE(archiveCount, 2u);
+  if (std::string(firstHour) == lastHour)
+  {
+    EXPECT_TRUE(std::filesystem::exists(m_testLogPath + "." + firstHour));
+    EXPECT_TRUE(std::filesystem::exists(m_testLogPath + "." + firstHour + ".1"));
+  }
+}
+
+#ifdef __linux__
+// Bytes the filesystem has allocated for path, which preallocation puts past its size
+static uint64_t allocatedBytes(const std::string &path)
+{
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 ? static_cast<uint64_t>(info.st_blocks) * 512 : 0;
+}
+
+// Test that the open file keeps an extent reserved and closed files give back what they didn't use
+TEST_F(LoggerTest, PreallocatedExtents)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.maxFileSize = 16 * 1024;
+  config.preallocateSize = 1024 * 1024;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  for (int i = 0; i < 1000; i++)
+  {
+    LOG_INFO("Preallocated message %d", i);
+  }
+  Logger::getInstance().flush();
+
+  uint64_t activeSize = std::filesystem::file_size(m_testLogPath);
+  if (allocatedBytes(m_testLogPath) <= activeSize)
+    GTEST_SKIP() << "fallocate() not supported here";
+
+  EXPECT_GE(allocatedBytes(m_testLogPath), config.preallocateSize);
+  EXPECT_LT(activeSize, config.preallocateSize);
+
+  std::string backupPath = m_testLogPath + ".bak";
+  ASSERT_TRUE(std::filesystem::exists(backupPath));
+  EXPECT_LT(allocatedBytes(backupPath), config.preallocateSize);
+  std::string backupContent = readLogFile(backupPath);
+  EXPECT_EQ(backupContent.find('\0'), std::string::npos);
+  EXPECT_EQ(backupContent.back(), '\n');
+}
+#endif
+
+// Test that reaching the end of a period archives the file under that period and schedules the next one
+TEST_F(LoggerTest, HourlyRotationAtPeriodEnd)
+{
+  LoggerConfig config;
+  config.logFilePath = m_testLogPath.c_str();
+  config.consoleOutput = false;
+  config.rotationInterval = RotationInterval::HOURLY;
+  ASSERT_TRUE(Logger::getInstance().init(config));
+
+  LOG_INFO("Before the hour ends");
+  Logger::getInstance().endRotationPeriodForTesting("20000101-23");
+  LOG_INFO("After the hour ends");
+  Logger::getInstance().flush();
+
+  std::string archiveContent = readLogFile(m_testLogPath + ".20000101-23");
+  EXPECT_NE(archiveContent.find("Before the hour ends\n"), std::string::npos);
+  EXPECT_EQ(archiveContent.find("After the hour ends"), std::string::npos);
+  std::string logContent = readLogFile(m_testLogPath);
+  EXPECT_NE(logContent.find("After the hour ends\n"), std::string::npos);
+
+  auto now = std::chrono::steady_clock::now();
+  EXPECT_GT(Logger::getInstance().nextRotationTimeForTesting(), now);
+  EXPECT_LE(Logger::getInstance().nextRotationTimeForTesting(), now + std::chrono::hours(1));
+}